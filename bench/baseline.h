@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "harness.h"
+
+namespace Bench {
+
+    inline bool writeJson(const std::string& path, const std::vector<Result>& results) {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+
+        std::fprintf(file, "{\"results\":[\n");
+        for (std::size_t i = 0; i < results.size(); i++) {
+            auto& result = results[i];
+            std::fprintf(file, "{\"name\":\"%s/%s\",\"items\":%zu,\"median\":%.6g,\"p95\":%.6g,\"samples\":[",
+                result.group.c_str(), result.variant.c_str(), result.items, result.median, result.p95);
+            for (std::size_t k = 0; k < result.samples.size(); k++) {
+                std::fprintf(file, k ? ",%.6g" : "%.6g", result.samples[k]);
+            }
+            std::fprintf(file, i + 1 < results.size() ? "]},\n" : "]}\n");
+        }
+        std::fprintf(file, "]}\n");
+        return std::fclose(file) == 0;
+    }
+
+    inline bool readJson(const std::string& path, std::unordered_map<std::string, std::vector<double>>& samples) {
+        std::ifstream file{ path };
+        if (!file) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            auto nameBegin = line.find("\"name\":\"");
+            auto samplesBegin = line.find("\"samples\":[");
+            if (nameBegin == std::string::npos || samplesBegin == std::string::npos) {
+                continue;
+            }
+
+            nameBegin += 8;
+            auto nameEnd = line.find('"', nameBegin);
+            auto& values = samples[line.substr(nameBegin, nameEnd - nameBegin)];
+
+            const char* cursor = line.c_str() + samplesBegin + 11;
+            while (*cursor && *cursor != ']') {
+                char* end;
+                values.push_back(std::strtod(cursor, &end));
+                if (end == cursor) {
+                    break;
+                }
+                cursor = *end == ',' ? end + 1 : end;
+            }
+        }
+        return true;
+    }
+
+    inline double mannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b) {
+        std::vector<std::pair<double, int>> values;
+        for (auto x : a) {
+            values.emplace_back(x, 0);
+        }
+        for (auto x : b) {
+            values.emplace_back(x, 1);
+        }
+        std::sort(values.begin(), values.end());
+
+        double n1 = static_cast<double>(a.size());
+        double n2 = static_cast<double>(b.size());
+        double n = n1 + n2;
+        double rankSum = 0;
+        double tieTerm = 0;
+        for (std::size_t i = 0; i < values.size();) {
+            auto j = i;
+            while (j < values.size() && values[j].first == values[i].first) {
+                j++;
+            }
+
+            double rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2;
+            double ties = static_cast<double>(j - i);
+            tieTerm += ties * ties * ties - ties;
+            for (auto k = i; k < j; k++) {
+                if (values[k].second == 0) {
+                    rankSum += rank;
+                }
+            }
+            i = j;
+        }
+
+        double u = rankSum - n1 * (n1 + 1) / 2;
+        double mean = n1 * n2 / 2;
+        double variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+        if (variance <= 0) {
+            return 1.0;
+        }
+
+        double delta = std::fabs(u - mean) - 0.5;
+        double z = (delta > 0 ? delta : 0) / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.0));
+    }
+
+    inline double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        auto mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    }
+
+    inline int compareToBaseline(const Options& options, const std::vector<Result>& results) {
+        std::unordered_map<std::string, std::vector<double>> baseline;
+        if (!readJson(options.baselinePath, baseline)) {
+            std::fprintf(stderr, "cannot read baseline %s\n", options.baselinePath.c_str());
+            return 2;
+        }
+
+        int regressions = 0;
+        std::printf("\n%-57s %10s %10s %8s %10s\n", "benchmark", "baseline", "current", "change", "p-value");
+        for (auto& result : results) {
+            auto name = result.group + "/" + result.variant;
+            auto found = baseline.find(name);
+            if (found == baseline.end() || found->second.empty()) {
+                continue;
+            }
+
+            auto before = median(found->second);
+            auto change = result.median / before - 1;
+            auto p = mannWhitneyPValue(found->second, result.samples);
+            const char* verdict = "";
+            if (p < options.alpha && change > options.threshold) {
+                verdict = "REGRESSION";
+                regressions++;
+            }
+            else if (p < options.alpha && change < -options.threshold) {
+                verdict = "improved";
+            }
+            std::printf("%-57s %10.3f %10.3f %+7.1f%% %10.2g %s\n", name.c_str(), before, result.median, change * 100, p, verdict);
+        }
+
+        std::printf("\n%d significant regression%s (alpha %.3g, threshold %.1f%%)\n",
+            regressions, regressions == 1 ? "" : "s", options.alpha, options.threshold * 100);
+        return regressions ? 1 : 0;
+    }
+
+    class CpuPinning {
+        std::string governorPath;
+        std::string previousGovernor;
+
+    public:
+        CpuPinning(int cpu) {
+            if (cpu < 0) {
+                return;
+            }
+
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (::sched_setaffinity(0, sizeof(set), &set) != 0) {
+                std::fprintf(stderr, "note: cannot pin to cpu %d, running unpinned\n", cpu);
+            }
+
+            governorPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor";
+            std::ifstream current{ governorPath };
+            if (!std::getline(current, previousGovernor) || previousGovernor == "performance") {
+                previousGovernor.clear();
+                return;
+            }
+
+            std::ofstream governor{ governorPath };
+            if (!(governor << "performance" << std::flush)) {
+                std::fprintf(stderr, "note: cannot set cpu %d governor (currently %s)\n", cpu, previousGovernor.c_str());
+                previousGovernor.clear();
+            }
+#else
+            std::fprintf(stderr, "note: cpu pinning is only supported on Linux\n");
+#endif
+        }
+
+        CpuPinning(const CpuPinning&) = delete;
+        CpuPinning& operator=(const CpuPinning&) = delete;
+
+        ~CpuPinning() {
+            if (!previousGovernor.empty()) {
+                std::ofstream governor{ governorPath };
+                governor << previousGovernor;
+            }
+        }
+    };
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef STREAMS_BENCH_CXX
+#define STREAMS_BENCH_CXX "c++"
+#endif
+
+#ifndef STREAMS_BENCH_INCLUDE
+#define STREAMS_BENCH_INCLUDE "../src"
+#endif
+
+namespace {
+
+    struct Options {
+        std::string compiler{ STREAMS_BENCH_CXX };
+        std::string include{ STREAMS_BENCH_INCLUDE };
+        std::string flags{ "-std=c++17 -O2" };
+        std::string workDir{ "compile_bench" };
+        std::string jsonPath;
+        std::vector<int> depths{ 0, 1, 2, 4, 8, 16, 32, 64 };
+        std::vector<std::string> headers{ "streams.h", "streams_profile.h", "streams_parallel.h", "streams_io.h", "streams_trace.h" };
+        int repetitions{ 3 };
+    };
+
+    struct Measurement {
+        int depth;
+        double milliseconds;
+        long textBytes;
+        long instantiations;
+    };
+
+    std::string stage(int idx) {
+        auto k = std::to_string(idx);
+        switch (idx % 8) {
+        case 0:
+        case 3:
+            return "        .map([](int x) { return x + " + k + "; })\n";
+        case 1:
+        case 5:
+            return "        .filter([](int x) { return x % " + std::to_string(idx + 2) + " != 0; })\n";
+        case 2:
+            return "        .tap([&](int x) { seen += x; })\n";
+        case 4:
+            return "        .limit(1 << 30)\n";
+        case 6:
+            return "        .flatMap([](int x) { return Stream::of(table + (x & 7), table + (x & 7) + 2); })\n";
+        default:
+            return "        .map([](int x) { return x ^ " + k + "; })\n";
+        }
+    }
+
+    // An empty header name generates the baseline translation unit without any include
+    void generate(const std::string& path, const std::string& header, int depth) {
+        std::ofstream file{ path };
+        if (!header.empty()) {
+            file << "#include \"" << header << "\"\n\n";
+        }
+        if (depth == 0) {
+            file << "long pipeline(const int* begin, const int* end) {\n    return end - begin;\n}\n";
+            return;
+        }
+
+        file << "static const int table[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };\n\n";
+        file << "long pipeline(const int* begin, const int* end) {\n";
+        file << "    long seen = 0;\n";
+        file << "    return seen + Stream::of(begin, end)\n";
+        for (int i = 0; i < depth; i++) {
+            file << stage(i);
+        }
+        file << "        .reduce([](int x, long accu) { return accu + x; }, 0L);\n}\n";
+    }
+
+    std::string capture(const std::string& command) {
+        std::string output;
+        if (std::FILE* pipe = ::popen(command.c_str(), "r")) {
+            char buffer[4096];
+            std::size_t num;
+            while ((num = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+                output.append(buffer, num);
+            }
+            ::pclose(pipe);
+        }
+        return output;
+    }
+
+    long textSize(const std::string& object) {
+        auto output = capture("size -A '" + object + "'");
+        long total = 0;
+        std::size_t pos = 0;
+        while (pos < output.size()) {
+            auto end = output.find('\n', pos);
+            end = end == std::string::npos ? output.size() : end;
+            auto line = output.substr(pos, end - pos);
+            if (line.rfind(".text", 0) == 0) {
+                auto sizeBegin = line.find_first_of("0123456789", line.find_first_of(" \t"));
+                total += std::strtol(line.c_str() + sizeBegin, nullptr, 10);
+            }
+            pos = end + 1;
+        }
+        return total;
+    }
+
+    long functionSymbols(const std::string& object) {
+        auto output = capture("nm --defined-only '" + object + "'");
+        long count = 0;
+        for (std::size_t i = 0; i + 3 < output.size(); i++) {
+            if (output[i] == ' ' && output[i + 2] == ' ' && (output[i + 1] == 'T' || output[i + 1] == 't' || output[i + 1] == 'W')) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    bool compile(const Options& options, const std::string& flags, const std::string& source, const std::string& object) {
+        auto command = options.compiler + " " + flags + " -I'" + options.include + "' -c '" + source + "' -o '" + object + "'";
+        return std::system(command.c_str()) == 0;
+    }
+
+    bool bestCompileTime(const Options& options, const std::string& source, const std::string& object, double& milliseconds) {
+        milliseconds = 1e300;
+        for (int i = 0; i < options.repetitions; i++) {
+            auto begin = std::chrono::steady_clock::now();
+            if (!compile(options, options.flags, source, object)) {
+                return false;
+            }
+            auto end = std::chrono::steady_clock::now();
+            milliseconds = std::min(milliseconds, std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+        return true;
+    }
+
+    bool measureHeader(const Options& options, const std::string& header, double& milliseconds) {
+        auto base = options.workDir + "/header_" + (header.empty() ? std::string{ "none" } : header.substr(0, header.find('.')));
+        generate(base + ".cpp", header, 0);
+        return bestCompileTime(options, base + ".cpp", base + ".o", milliseconds);
+    }
+
+    bool measure(const Options& options, int depth, Measurement& result) {
+        auto base = options.workDir + "/pipeline_" + std::to_string(depth);
+        generate(base + ".cpp", "streams.h", depth);
+
+        double best;
+        if (!bestCompileTime(options, base + ".cpp", base + ".o", best)) {
+            return false;
+        }
+
+        if (!compile(options, options.flags + " -O0", base + ".cpp", base + "_O0.o")) {
+            return false;
+        }
+
+        result = { depth, best, textSize(base + ".o"), functionSymbols(base + "_O0.o") };
+        return true;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            auto arg = std::string{ argv[i] };
+            auto value = [&]() -> std::string {
+                return i + 1 < argc ? argv[++i] : "";
+            };
+
+            if (arg == "--compiler") {
+                options.compiler = value();
+            }
+            else if (arg == "--include") {
+                options.include = value();
+            }
+            else if (arg == "--flags") {
+                options.flags = value();
+            }
+            else if (arg == "--work-dir") {
+                options.workDir = value();
+            }
+            else if (arg == "--json") {
+                options.jsonPath = value();
+            }
+            else if (arg == "--repetitions") {
+                options.repetitions = std::max(1, std::atoi(value().c_str()));
+            }
+            else if (arg == "--max-depth") {
+                int maxDepth = std::atoi(value().c_str());
+                options.depths.erase(std::remove_if(options.depths.begin(), options.depths.end(), [&](int d) { return d > maxDepth; }), options.depths.end());
+            }
+            else {
+                std::fprintf(stderr,
+                    "usage: %s [--compiler path] [--include dir] [--flags \"...\"] [--work-dir dir]\n"
+                    "          [--repetitions n] [--max-depth n] [--json out.json]\n", argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::system(("mkdir -p '" + options.workDir + "'").c_str());
+
+    // Every time is also reported against a translation unit that includes nothing, so the cost of the include itself stays visible
+    double baseline;
+    if (!measureHeader(options, "", baseline)) {
+        std::fprintf(stderr, "baseline compilation failed\n");
+        return 2;
+    }
+
+    std::printf("%-20s %12s %15s\n", "header", "compile ms", "vs baseline ms");
+    std::printf("%-20s %12.1f %15.1f\n", "(none)", baseline, 0.0);
+    std::vector<double> headerTimes;
+    for (auto& header : options.headers) {
+        double milliseconds;
+        if (!measureHeader(options, header, milliseconds)) {
+            std::fprintf(stderr, "compilation failed for %s\n", header.c_str());
+            return 2;
+        }
+
+        std::printf("%-20s %12.1f %15.1f\n", header.c_str(), milliseconds, milliseconds - baseline);
+        std::fflush(stdout);
+        headerTimes.push_back(milliseconds);
+    }
+
+    std::printf("\n%6s %12s %15s %14s %12s %15s\n", "depth", "compile ms", "vs baseline ms", "vs depth 0 ms", ".text bytes", "functions -O0");
+    std::vector<Measurement> results;
+    double depthZero = 0;
+    for (int depth : options.depths) {
+        Measurement result;
+        if (!measure(options, depth, result)) {
+            std::fprintf(stderr, "compilation failed at depth %d\n", depth);
+            return 2;
+        }
+        if (depth == 0) {
+            depthZero = result.milliseconds;
+        }
+
+        std::printf("%6d %12.1f %15.1f %14.1f %12ld %15ld\n", depth, result.milliseconds, result.milliseconds - baseline, result.milliseconds - depthZero, result.textBytes, result.instantiations);
+        std::fflush(stdout);
+        results.push_back(result);
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream file{ options.jsonPath };
+        file << "{\"baselineMilliseconds\":" << baseline << ",\n\"headers\":[\n";
+        for (std::size_t i = 0; i < headerTimes.size(); i++) {
+            file << "{\"header\":\"" << options.headers[i] << "\",\"milliseconds\":" << headerTimes[i]
+                << (i + 1 < headerTimes.size() ? "},\n" : "}\n");
+        }
+        file << "],\n\"results\":[\n";
+        for (std::size_t i = 0; i < results.size(); i++) {
+            auto& result = results[i];
+            file << "{\"depth\":" << result.depth << ",\"milliseconds\":" << result.milliseconds
+                << ",\"textBytes\":" << result.textBytes << ",\"functions\":" << result.instantiations
+                << (i + 1 < results.size() ? "},\n" : "}\n");
+        }
+        file << "]}\n";
+    }
+    return 0;
+}
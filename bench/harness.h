@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Bench {
+
+    template<typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    template<typename T>
+    inline void doNotOptimize(T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : "+m"(value) : : "memory");
+#else
+        static volatile void* sink;
+        sink = &value;
+#endif
+    }
+
+    inline void clobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+#endif
+    }
+
+    struct Options {
+        std::string filter;
+        std::size_t maxBytes{ std::size_t{ 32 } << 20 };
+        int warmup{ 3 };
+        int repetitions{ 15 };
+        double minSampleNanoseconds{ 2e5 };
+        std::string jsonPath;
+        std::string baselinePath;
+        double alpha{ 0.01 };
+        double threshold{ 0.05 };
+        int pinCpu{ -1 };
+    };
+
+    struct Result {
+        std::string group;
+        std::string variant;
+        std::size_t items{ 0 };
+        std::vector<double> samples;
+        double median{ 0 };
+        double p95{ 0 };
+    };
+
+    class Registry {
+        struct Entry {
+            std::string group;
+            std::string variant;
+            std::size_t items;
+            std::function<void()> body;
+        };
+
+        std::vector<Entry> entries;
+
+        static double percentile(std::vector<double> values, double fraction) {
+            std::sort(values.begin(), values.end());
+            auto idx = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+            return values[idx];
+        }
+
+        static double timeBatch(const Entry& entry, std::size_t iterations) {
+            auto begin = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < iterations; i++) {
+                entry.body();
+                clobberMemory();
+            }
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(end - begin).count();
+        }
+
+    public:
+        void add(std::string group, std::string variant, std::size_t items, std::function<void()> body) {
+            entries.push_back({ std::move(group), std::move(variant), items, std::move(body) });
+        }
+
+        std::vector<Result> run(const Options& options) const {
+            std::vector<Result> results;
+            for (auto& entry : entries) {
+                auto name = entry.group + "/" + entry.variant;
+                if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+                    continue;
+                }
+
+                std::size_t iterations = 1;
+                for (int i = 0; i < options.warmup; i++) {
+                    auto nanoseconds = timeBatch(entry, iterations);
+                    while (nanoseconds < options.minSampleNanoseconds && iterations < (std::size_t{ 1 } << 30)) {
+                        iterations *= 2;
+                        nanoseconds *= 2;
+                    }
+                }
+
+                Result result;
+                result.group = entry.group;
+                result.variant = entry.variant;
+                result.items = entry.items;
+                for (int i = 0; i < options.repetitions; i++) {
+                    auto nanoseconds = timeBatch(entry, iterations);
+                    result.samples.push_back(nanoseconds / static_cast<double>(iterations * (entry.items ? entry.items : 1)));
+                }
+                result.median = percentile(result.samples, 0.5);
+                result.p95 = percentile(result.samples, 0.95);
+                results.push_back(std::move(result));
+
+                auto& last = results.back();
+                std::printf("%-48s %-8s %10.3f %10.3f", last.group.c_str(), last.variant.c_str(), last.median, last.p95);
+                for (auto& other : results) {
+                    if (other.group == last.group && other.variant == "loop" && &other != &last) {
+                        std::printf(" %8.2fx", last.median / other.median);
+                    }
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+            return results;
+        }
+    };
+
+    inline bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            auto arg = std::string{ argv[i] };
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : "";
+            };
+
+            if (arg == "--filter") {
+                options.filter = value();
+            }
+            else if (arg == "--max-bytes") {
+                options.maxBytes = std::strtoull(value(), nullptr, 10);
+            }
+            else if (arg == "--warmup") {
+                options.warmup = std::atoi(value());
+            }
+            else if (arg == "--repetitions") {
+                options.repetitions = std::atoi(value());
+            }
+            else if (arg == "--json") {
+                options.jsonPath = value();
+            }
+            else if (arg == "--baseline") {
+                options.baselinePath = value();
+            }
+            else if (arg == "--alpha") {
+                options.alpha = std::atof(value());
+            }
+            else if (arg == "--threshold") {
+                options.threshold = std::atof(value());
+            }
+            else if (arg == "--pin") {
+                options.pinCpu = std::atoi(value());
+            }
+            else {
+                std::fprintf(stderr,
+                    "usage: %s [--filter text] [--max-bytes n] [--warmup n] [--repetitions n]\n"
+                    "          [--json out.json] [--baseline base.json] [--alpha p] [--threshold fraction] [--pin cpu]\n", argv[0]);
+                return false;
+            }
+        }
+
+        options.repetitions = options.repetitions > 0 ? options.repetitions : 1;
+        return true;
+    }
+
+    inline void printHeader() {
+        std::printf("%-48s %-8s %10s %10s %9s\n", "benchmark", "variant", "median", "p95", "vs loop");
+        std::printf("%-48s %-8s %10s %10s\n", "", "", "ns/elem", "ns/elem");
+    }
+}
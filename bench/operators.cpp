@@ -0,0 +1,433 @@
+#include <cstdint>
+#include <cstdio>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "baseline.h"
+#include "harness.h"
+#include "streams.h"
+
+namespace {
+
+    struct Payload {
+        std::uint64_t fields[8];
+    };
+
+    template<typename T>
+    struct Traits;
+
+    template<>
+    struct Traits<int> {
+        static constexpr const char* name = "int";
+
+        static int make(std::size_t i) {
+            return static_cast<int>((i * 2654435761u) >> 8);
+        }
+
+        static std::int64_t transform(const int& x) {
+            return static_cast<std::int64_t>(x) * 3 + 1;
+        }
+
+        static bool keep(const int& x) {
+            return x & 1;
+        }
+    };
+
+    template<>
+    struct Traits<double> {
+        static constexpr const char* name = "double";
+
+        static double make(std::size_t i) {
+            return static_cast<double>(Traits<int>::make(i)) * 0.5;
+        }
+
+        static double transform(const double& x) {
+            return x * 1.5 + 1.0;
+        }
+
+        static bool keep(const double& x) {
+            return static_cast<std::int64_t>(x) & 1;
+        }
+    };
+
+    template<>
+    struct Traits<Payload> {
+        static constexpr const char* name = "payload64";
+
+        static Payload make(std::size_t i) {
+            Payload payload;
+            for (int k = 0; k < 8; k++) {
+                payload.fields[k] = static_cast<std::uint64_t>(Traits<int>::make(i)) + k;
+            }
+            return payload;
+        }
+
+        static std::uint64_t transform(const Payload& x) {
+            return x.fields[0] + x.fields[7];
+        }
+
+        static bool keep(const Payload& x) {
+            return x.fields[3] & 1;
+        }
+    };
+
+    template<>
+    struct Traits<std::string> {
+        static constexpr const char* name = "string";
+
+        static std::string make(std::size_t i) {
+            auto text = "element-" + std::to_string(Traits<int>::make(i));
+            text.resize(24, '.');
+            return text;
+        }
+
+        static std::uint64_t transform(const std::string& x) {
+            return x.size() + static_cast<unsigned char>(x[8]);
+        }
+
+        static bool keep(const std::string& x) {
+            return x[8] & 1;
+        }
+    };
+
+    template<typename T>
+    void addBenchmarks(Bench::Registry& registry, const std::vector<T>& data, const std::string& suffix) {
+        using Tr = Traits<T>;
+        using R = decltype(Tr::transform(data[0]));
+
+        const T* begin = data.data();
+        const T* end = begin + data.size();
+        auto n = data.size();
+        auto span = std::span<const T>{ begin, end };
+        auto group = [&](const char* op) {
+            return std::string{ op } + "/" + Tr::name + "/" + suffix;
+        };
+        auto sum = [](R x, R accu) {
+            return accu + x;
+        };
+
+        std::vector<std::pair<const T*, const T*>> spans;
+        for (std::size_t i = 0; i < n; i += 8) {
+            spans.emplace_back(begin + i, begin + (i + 8 < n ? i + 8 : n));
+        }
+        auto spansData = std::make_shared<std::vector<std::pair<const T*, const T*>>>(std::move(spans));
+        auto output = std::make_shared<std::vector<R>>();
+        output->reserve(n);
+
+        registry.add(group("map"), "loop", n, [=]() {
+            R accu{};
+            for (auto it = begin; it != end; it++) {
+                accu += Tr::transform(*it);
+            }
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("map"), "streams", n, [=]() {
+            R accu{};
+            Stream::of(begin, end).map(Tr::transform).forEach([&](R x) { accu += x; });
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("map"), "ranges", n, [=]() {
+            R accu{};
+            for (auto x : span | std::views::transform(Tr::transform)) {
+                accu += x;
+            }
+            Bench::doNotOptimize(accu);
+        });
+
+        registry.add(group("filter"), "loop", n, [=]() {
+            int count = 0;
+            for (auto it = begin; it != end; it++) {
+                count += Tr::keep(*it) ? 1 : 0;
+            }
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("filter"), "streams", n, [=]() {
+            auto count = Stream::of(begin, end).filter(Tr::keep).count();
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("filter"), "ranges", n, [=]() {
+            auto count = std::ranges::distance(span | std::views::filter(Tr::keep));
+            Bench::doNotOptimize(count);
+        });
+
+        registry.add(group("flatMap"), "loop", n, [=]() {
+            R accu{};
+            for (auto& [first, last] : *spansData) {
+                for (auto it = first; it != last; it++) {
+                    accu += Tr::transform(*it);
+                }
+            }
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("flatMap"), "streams", n, [=]() {
+            auto& outer = *spansData;
+            auto accu = Stream::of(outer.data(), outer.data() + outer.size())
+                .flatMap([](std::pair<const T*, const T*> x) { return Stream::of(x.first, x.second); })
+                .map(Tr::transform)
+                .reduce(sum, R{});
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("flatMap"), "ranges", n, [=]() {
+            R accu{};
+            auto toSpan = [](const std::pair<const T*, const T*>& x) { return std::span<const T>{ x.first, x.second }; };
+            for (auto x : *spansData | std::views::transform(toSpan) | std::views::join | std::views::transform(Tr::transform)) {
+                accu += x;
+            }
+            Bench::doNotOptimize(accu);
+        });
+
+        registry.add(group("limit"), "loop", n / 2, [=]() {
+            int count = 0;
+            for (auto it = begin; it != begin + n / 2; it++) {
+                const T value = *it;
+                Bench::doNotOptimize(value);
+                count++;
+            }
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("limit"), "streams", n / 2, [=]() {
+            auto count = Stream::of(begin, end).limit(static_cast<int>(n / 2)).tap([](const T& value) { Bench::doNotOptimize(value); }).count();
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("limit"), "ranges", n / 2, [=]() {
+            int count = 0;
+            for (const T& ref : span | std::views::take(n / 2)) {
+                const T value = ref;
+                Bench::doNotOptimize(value);
+                count++;
+            }
+            Bench::doNotOptimize(count);
+        });
+
+        registry.add(group("tap"), "loop", n, [=]() {
+            R accu{};
+            int count = 0;
+            for (auto it = begin; it != end; it++) {
+                accu += Tr::transform(*it);
+                count++;
+            }
+            Bench::doNotOptimize(accu);
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("tap"), "streams", n, [=]() {
+            R accu{};
+            auto count = Stream::of(begin, end).tap([&](const T& x) { accu += Tr::transform(x); }).count();
+            Bench::doNotOptimize(accu);
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("tap"), "ranges", n, [=]() {
+            R accu{};
+            int count = 0;
+            auto tap = [&](const T& x) -> const T& { accu += Tr::transform(x); return x; };
+            for (auto& x : span | std::views::transform(tap)) {
+                Bench::doNotOptimize(x);
+                count++;
+            }
+            Bench::doNotOptimize(accu);
+            Bench::doNotOptimize(count);
+        });
+
+        registry.add(group("reduce"), "loop", n, [=]() {
+            R accu{};
+            for (auto it = begin; it != end; it++) {
+                accu = sum(Tr::transform(*it), accu);
+            }
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("reduce"), "streams", n, [=]() {
+            auto accu = Stream::of(begin, end).map(Tr::transform).reduce(sum, R{});
+            Bench::doNotOptimize(accu);
+        });
+        registry.add(group("reduce"), "ranges", n, [=]() {
+            R accu{};
+            for (auto x : span | std::views::transform(Tr::transform)) {
+                accu = sum(x, accu);
+            }
+            Bench::doNotOptimize(accu);
+        });
+
+        registry.add(group("count"), "loop", n, [=]() {
+            int count = 0;
+            for (auto it = begin; it != end; it++) {
+                const T value = *it;
+                Bench::doNotOptimize(value);
+                count++;
+            }
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("count"), "streams", n, [=]() {
+            auto count = Stream::of(begin, end).tap([](const T& value) { Bench::doNotOptimize(value); }).count();
+            Bench::doNotOptimize(count);
+        });
+        registry.add(group("count"), "ranges", n, [=]() {
+            int count = 0;
+            for (const T& ref : span) {
+                const T value = ref;
+                Bench::doNotOptimize(value);
+                count++;
+            }
+            Bench::doNotOptimize(count);
+        });
+
+        registry.add(group("anyMatch"), "loop", n, [=]() {
+            R missing{ 0 };
+            Bench::doNotOptimize(missing);
+            bool found = false;
+            for (auto it = begin; it != end && !found; it++) {
+                found = Tr::transform(*it) == missing;
+            }
+            Bench::doNotOptimize(found);
+        });
+        registry.add(group("anyMatch"), "streams", n, [=]() {
+            R missing{ 0 };
+            Bench::doNotOptimize(missing);
+            auto found = Stream::of(begin, end).anyMatch([&](const T& x) { return Tr::transform(x) == missing; });
+            Bench::doNotOptimize(found);
+        });
+        registry.add(group("anyMatch"), "ranges", n, [=]() {
+            R missing{ 0 };
+            Bench::doNotOptimize(missing);
+            auto found = std::ranges::any_of(span, [&](const T& x) { return Tr::transform(x) == missing; });
+            Bench::doNotOptimize(found);
+        });
+
+        registry.add(group("emplaceInto"), "loop", n, [=]() {
+            output->clear();
+            for (auto it = begin; it != end; it++) {
+                output->emplace_back(Tr::transform(*it));
+            }
+            Bench::doNotOptimize(output->data());
+        });
+        registry.add(group("emplaceInto"), "streams", n, [=]() {
+            output->clear();
+            Stream::of(begin, end).map(Tr::transform).emplaceInto(*output);
+            Bench::doNotOptimize(output->data());
+        });
+        registry.add(group("emplaceInto"), "ranges", n, [=]() {
+            output->clear();
+            std::ranges::copy(span | std::views::transform(Tr::transform), std::back_inserter(*output));
+            Bench::doNotOptimize(output->data());
+        });
+
+        if constexpr (std::is_integral_v<R>) {
+            auto odd = [](R x) { return (x & 1) != 0; };
+            registry.add(group("map.filter.reduce"), "loop", n, [=]() {
+                R accu{};
+                for (auto it = begin; it != end; it++) {
+                    auto x = Tr::transform(*it);
+                    if (odd(x)) {
+                        accu += x;
+                    }
+                }
+                Bench::doNotOptimize(accu);
+            });
+            registry.add(group("map.filter.reduce"), "streams", n, [=]() {
+                auto accu = Stream::of(begin, end).map(Tr::transform).filter(odd).reduce(sum, R{});
+                Bench::doNotOptimize(accu);
+            });
+            registry.add(group("map.filter.reduce"), "ranges", n, [=]() {
+                R accu{};
+                for (auto x : span | std::views::transform(Tr::transform) | std::views::filter(odd)) {
+                    accu += x;
+                }
+                Bench::doNotOptimize(accu);
+            });
+        }
+
+        if constexpr (std::is_floating_point_v<R>) {
+            registry.add(group("sumPrecise"), "loop", n, [=]() {
+                double accu = 0;
+                double compensation = 0;
+                for (auto it = begin; it != end; it++) {
+                    double y = Tr::transform(*it) - compensation;
+                    double t = accu + y;
+                    compensation = (t - accu) - y;
+                    accu = t;
+                }
+                Bench::doNotOptimize(accu);
+            });
+            registry.add(group("sumPrecise"), "streams", n, [=]() {
+                auto accu = Stream::of(begin, end).map(Tr::transform).sumPrecise();
+                Bench::doNotOptimize(accu);
+            });
+        }
+
+        registry.add(group("filter.map.limit.emplaceInto"), "loop", n, [=]() {
+            output->clear();
+            auto limit = n / 4;
+            for (auto it = begin; it != end && output->size() < limit; it++) {
+                if (Tr::keep(*it)) {
+                    output->emplace_back(Tr::transform(*it));
+                }
+            }
+            Bench::doNotOptimize(output->data());
+        });
+        registry.add(group("filter.map.limit.emplaceInto"), "streams", n, [=]() {
+            output->clear();
+            Stream::of(begin, end).filter(Tr::keep).map(Tr::transform).limit(static_cast<int>(n / 4)).emplaceInto(*output);
+            Bench::doNotOptimize(output->data());
+        });
+        registry.add(group("filter.map.limit.emplaceInto"), "ranges", n, [=]() {
+            output->clear();
+            auto view = span | std::views::filter(Tr::keep) | std::views::transform(Tr::transform) | std::views::take(n / 4);
+            std::ranges::copy(view, std::back_inserter(*output));
+            Bench::doNotOptimize(output->data());
+        });
+    }
+
+    template<typename T>
+    void runType(const Bench::Options& options, std::vector<Bench::Result>& results) {
+        const std::pair<std::size_t, const char*> sizes[] = {
+            { std::size_t{ 16 } << 10, "16KiB" },
+            { std::size_t{ 1 } << 20, "1MiB" },
+            { std::size_t{ 32 } << 20, "32MiB" },
+            { std::size_t{ 512 } << 20, "512MiB" }
+        };
+
+        for (auto& [bytes, label] : sizes) {
+            if (bytes > options.maxBytes) {
+                continue;
+            }
+
+            std::vector<T> data;
+            auto n = bytes / sizeof(T);
+            data.reserve(n);
+            for (std::size_t i = 0; i < n; i++) {
+                data.push_back(Traits<T>::make(i));
+            }
+
+            Bench::Registry registry;
+            addBenchmarks(registry, data, label);
+            for (auto& result : registry.run(options)) {
+                results.push_back(std::move(result));
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Bench::Options options;
+    if (!Bench::parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    Bench::CpuPinning pinning{ options.pinCpu };
+    std::vector<Bench::Result> results;
+    Bench::printHeader();
+    runType<int>(options, results);
+    runType<double>(options, results);
+    runType<Payload>(options, results);
+    runType<std::string>(options, results);
+
+    if (!options.jsonPath.empty() && !Bench::writeJson(options.jsonPath, results)) {
+        std::fprintf(stderr, "cannot write %s\n", options.jsonPath.c_str());
+        return 2;
+    }
+    if (!options.baselinePath.empty()) {
+        return Bench::compareToBaseline(options, results);
+    }
+    return 0;
+}
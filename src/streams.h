@@ -1,9 +1,95 @@
-﻿namespace Stream {
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Only detects the platform; the headers themselves are included by streams_io.h, streams_parallel.h and streams_profile.h
+#if defined(__unix__) || defined(__APPLE__)
+#define STREAMS_HAS_POSIX 1
+#endif
+
+#ifdef __linux__
+#define STREAMS_HAS_AFFINITY 1
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define STREAMS_HAS_IO_URING 1
+#endif
+#if __has_include(<linux/perf_event.h>)
+#define STREAMS_HAS_PERF_EVENTS 1
+#endif
+#endif
+
+#if defined(STREAMS_DEFINE_ALLOCATION_HOOKS) && !defined(STREAMS_COUNT_ALLOCATIONS)
+#define STREAMS_COUNT_ALLOCATIONS 1
+#endif
+
+#ifdef __cpp_lib_constexpr_dynamic_alloc
+#define STREAMS_CONSTEXPR constexpr
+#else
+#define STREAMS_CONSTEXPR
+#endif
+
+#ifndef STREAMS_MAX_UNROLL
+#define STREAMS_MAX_UNROLL 16
+#endif
+
+#ifndef STREAMS_PROFILE_SAMPLE_INTERVAL
+#define STREAMS_PROFILE_SAMPLE_INTERVAL 16
+#endif
+
+#ifndef STREAMS_CHUNK_NANOSECONDS
+#define STREAMS_CHUNK_NANOSECONDS 100000
+#endif
+
+namespace Stream {
+
+    inline constexpr std::size_t dynamicExtent = ~std::size_t{ 0 };
 
     namespace Detail {
 
         struct Exception {};
 
+        struct IOException : Exception {
+            int error;
+
+            IOException(int e)
+                : error{ e } {}
+        };
+
+        struct AllocationError : Exception {
+            std::uint64_t allocations;
+
+            AllocationError(std::uint64_t a)
+                : allocations{ a } {}
+        };
+
         template<typename T> struct removeReference      { using type = T; };
         template<typename T> struct removeReference<T&>  { using type = T; };
         template<typename T> struct removeReference<T&&> { using type = T; };
@@ -22,425 +108,730 @@
                 char space[sizeof(T)];
                 T value;
 
-                Storage() : space{} {}
-                Storage(const T& x) : value{ x } {}
-                Storage(T&& x) : value{ move(x) } {}
+                STREAMS_CONSTEXPR Storage() : space{} {}
+                STREAMS_CONSTEXPR Storage(const T& x) : value{ x } {}
+                STREAMS_CONSTEXPR Storage(T&& x) : value{ Detail::move(x) } {}
+                STREAMS_CONSTEXPR ~Storage() {}
             } data;
 
         public:
-            TypedStorage()
+            STREAMS_CONSTEXPR TypedStorage()
                 : data{} {}
 
-            TypedStorage(const T& x)
+            STREAMS_CONSTEXPR TypedStorage(const T& x)
                 : data{ x } {}
 
-            TypedStorage(T&& x)
-                : data{ move(x) } {}
+            STREAMS_CONSTEXPR TypedStorage(T&& x)
+                : data{ Detail::move(x) } {}
 
-            void construct(const T& x) {
+            STREAMS_CONSTEXPR void construct(const T& x) {
+#ifdef __cpp_lib_constexpr_dynamic_alloc
+                std::construct_at(&data.value, x);
+#else
                 new(&data.value) T(x);
+#endif
             }
 
-            void construct(T&& x) {
-                new(&data.value) T(move(x));
+            STREAMS_CONSTEXPR void construct(T&& x) {
+#ifdef __cpp_lib_constexpr_dynamic_alloc
+                std::construct_at(&data.value, Detail::move(x));
+#else
+                new(&data.value) T(Detail::move(x));
+#endif
             }
 
-            void destruct() {
+            STREAMS_CONSTEXPR void destruct() {
+#ifdef __cpp_lib_constexpr_dynamic_alloc
+                std::destroy_at(&data.value);
+#else
                 data.value.~T();
+#endif
             }
 
-            T& get() {
+            STREAMS_CONSTEXPR T& get() {
                 return data.value;
             }
 
-            const T& get() const {
+            STREAMS_CONSTEXPR const T& get() const {
                 return data.value;
             }
         };
-    }
-
-    template<typename TIt>
-    class EmptyStream;
-
-    template<typename TIt>
-    class VectorStream;
 
-    template<typename TIt, typename TLam>
-    class MapStream;
+        template<typename TIt, typename = void>
+        struct ExtentOf {
+            static constexpr std::size_t value = dynamicExtent;
+        };
 
-    template<typename TIt, typename TLam>
-    class FlatMapStream;
+        template<typename TIt>
+        struct ExtentOf<TIt, std::void_t<decltype(TIt::extent)>> {
+            static constexpr std::size_t value = TIt::extent;
+        };
 
-    template<typename TIt, typename TLam>
-    class FilterStream;
+        template<typename TIt>
+        inline constexpr std::size_t extentOf = ExtentOf<TIt>::value;
 
-    template<typename TIt, typename TLam>
-    class TapStream;
+        template<typename TFunc, std::size_t... idx>
+        STREAMS_CONSTEXPR void unroll(TFunc&& f, std::index_sequence<idx...>) {
+            ((void(idx), f()), ...);
+        }
 
-    template<typename TIt>
-    class LimitStream;
+        template<typename TIt, std::size_t... idx>
+        STREAMS_CONSTEXPR auto collectArray(TIt& it, std::index_sequence<idx...>) {
+            using TValue = decltype(it.next());
+            return std::array<TValue, sizeof...(idx)>{ { (void(idx), it.next())... } };
+        }
 
-    template<typename TContainer>
-    auto of(TContainer& container) {
-        return VectorStream<typename TContainer::iterator>{ container.begin(), container.end() };
-    }
+        class PreciseSum {
+            static constexpr int lanes = 8;
+            static constexpr int batch = 256;
 
-    template<typename T>
-    auto of(T* begin, T* end) {
-        return VectorStream<T*>{ begin, end };
-    }
+            double sums[lanes]{};
+            double compensations[lanes]{};
+            double buffer[batch];
+            int buffered{ 0 };
 
-    template<typename T>
-    auto of(const T* begin, const T* end) {
-        return VectorStream<const T*>{ begin, end };
-    }
+            static void accumulate(double& sum, double& compensation, double x) {
+                double t = sum + x;
+                double z = t - sum;
+                compensation += (sum - (t - z)) + (x - z);
+                sum = t;
+            }
 
-    template<typename T, std::size_t size>
-    auto of(T(&data)[size]) {
-        return VectorStream<T*>{ data, data + size };
-    }
+            void flush() {
+#if defined(__SSE2__) || defined(_M_X64)
+                __m128d s[lanes / 2];
+                __m128d c[lanes / 2];
+                for (int k = 0; k < lanes / 2; k++) {
+                    s[k] = _mm_loadu_pd(sums + 2 * k);
+                    c[k] = _mm_loadu_pd(compensations + 2 * k);
+                }
+                for (int i = 0; i < batch; i += lanes) {
+                    for (int k = 0; k < lanes / 2; k++) {
+                        auto x = _mm_loadu_pd(buffer + i + 2 * k);
+                        auto t = _mm_add_pd(s[k], x);
+                        auto z = _mm_sub_pd(t, s[k]);
+                        c[k] = _mm_add_pd(c[k], _mm_add_pd(_mm_sub_pd(s[k], _mm_sub_pd(t, z)), _mm_sub_pd(x, z)));
+                        s[k] = t;
+                    }
+                }
+                for (int k = 0; k < lanes / 2; k++) {
+                    _mm_storeu_pd(sums + 2 * k, s[k]);
+                    _mm_storeu_pd(compensations + 2 * k, c[k]);
+                }
+#else
+                for (int i = 0; i < batch; i += lanes) {
+                    for (int lane = 0; lane < lanes; lane++) {
+                        accumulate(sums[lane], compensations[lane], buffer[i + lane]);
+                    }
+                }
+#endif
+                buffered = 0;
+            }
 
-    template<typename T, std::size_t size>
-    auto of(const T(&data)[size]) {
-        return VectorStream<const T*>{ data, data + size };
-    }
+        public:
+            void add(double x) {
+                buffer[buffered++] = x;
+                if (buffered == batch) {
+                    flush();
+                }
+            }
 
-    template<typename T>
-    auto empty() {
-        return EmptyStream<T>{};
-    }
+            template<typename TIt>
+            void addAll(TIt& it) {
+                while (it.hasNext()) {
+                    int num = buffered;
+                    while (num < batch && it.hasNext()) {
+                        buffer[num++] = static_cast<double>(it.next());
+                    }
+                    buffered = num;
+                    if (buffered == batch) {
+                        flush();
+                    }
+                }
+            }
 
+            void merge(const PreciseSum& other) {
+                for (int lane = 0; lane < lanes; lane++) {
+                    accumulate(sums[lane], compensations[lane], other.sums[lane]);
+                    compensations[lane] += other.compensations[lane];
+                }
+                for (int i = 0; i < other.buffered; i++) {
+                    add(other.buffer[i]);
+                }
+            }
 
-    template<typename TIt>
-    class Stream {
-    protected:
-        using TIterator = TIt;
+            double result() const {
+                double sum = 0;
+                double compensation = 0;
+                for (int lane = 0; lane < lanes; lane++) {
+                    accumulate(sum, compensation, sums[lane]);
+                    compensation += compensations[lane];
+                }
+                for (int i = 0; i < buffered; i++) {
+                    accumulate(sum, compensation, buffer[i]);
+                }
+                return sum + compensation;
+            }
+        };
 
-        TIterator iterator;
+        struct MakePair {
+            template<typename TFirst, typename TSecond>
+            STREAMS_CONSTEXPR auto operator()(TFirst a, TSecond b) const {
+                return std::pair<TFirst, TSecond>{ Detail::move(a), Detail::move(b) };
+            }
+        };
 
-    public:
-        Stream(TIterator it)
-            : iterator{ Detail::move(it) } {}
+        struct IgnoreParseErrors {
+            void operator()(std::string_view, std::errc) const {}
+        };
 
-        auto& getIterator() {
-            return iterator;
+        inline std::uint64_t loadEightBytes(const char* ptr) {
+            std::uint64_t chunk;
+            std::memcpy(&chunk, ptr, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            chunk = __builtin_bswap64(chunk);
+#endif
+            return chunk;
         }
 
-        template<typename TLam>
-        auto map(TLam lambda) {
-            return MapStream<TIterator, TLam>{ iterator, lambda };
+        // SWAR digit check and conversion of eight ASCII digits loaded in little endian order
+        inline bool isEightDigits(std::uint64_t chunk) {
+            return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
         }
 
-        template<typename TLam>
-        auto flatMap(TLam lambda) {
-            return FlatMapStream<TIterator, TLam>{ iterator, lambda };
+        inline std::uint32_t parseEightDigits(std::uint64_t chunk) {
+            chunk = ((chunk & 0x0F0F0F0F0F0F0F0F) * 2561) >> 8;
+            chunk = ((chunk & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+            return static_cast<std::uint32_t>(((chunk & 0x0000FFFF0000FFFF) * 42949672960001) >> 32);
         }
 
-        template<typename TLam>
-        auto filter(TLam lambda) {
-            return FilterStream<TIterator, TLam>{ iterator, lambda };
-        }
+        template<typename T>
+        struct FromCharsParser {
+            using Type = T;
 
-        template<typename TLam>
-        auto tap(TLam lambda) {
-            return TapStream<TIterator, TLam>{ iterator, lambda };
-        }
+            std::errc operator()(std::string_view str, T& value) const {
+                auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+                if (result.ec == std::errc{} && result.ptr != str.data() + str.size()) {
+                    return std::errc::invalid_argument;
+                }
 
-        auto limit(int size) {
-            return LimitStream<TIterator>{ iterator, size };
-        }
+                return result.ec;
+            }
+        };
 
-        void sink() {
-            while (iterator.hasNext()) {
-                iterator.next();
+        template<typename T, int digits>
+        struct FixedWidthParser {
+            static_assert(digits > 0 && digits <= 19, "Fixed width fields have to fit into 64 bits");
+
+            using Type = T;
+
+            std::errc operator()(std::string_view str, T& value) const {
+                if (str.size() != digits) {
+                    return std::errc::invalid_argument;
+                }
+
+                const char* ptr = str.data();
+                std::uint64_t accu = 0;
+                int idx = 0;
+                for (; idx + 8 <= digits; idx += 8) {
+                    auto chunk = loadEightBytes(ptr + idx);
+                    if (!isEightDigits(chunk)) {
+                        return std::errc::invalid_argument;
+                    }
+                    accu = accu * 100000000 + parseEightDigits(chunk);
+                }
+
+                for (; idx < digits; idx++) {
+                    if (ptr[idx] < '0' || ptr[idx] > '9') {
+                        return std::errc::invalid_argument;
+                    }
+                    accu = accu * 10 + (ptr[idx] - '0');
+                }
+
+                if (accu > static_cast<std::uint64_t>(std::numeric_limits<T>::max())) {
+                    return std::errc::result_out_of_range;
+                }
+
+                value = static_cast<T>(accu);
+                return std::errc{};
             }
+        };
+
+        struct AllocationCounters {
+            std::uint64_t allocations{ 0 };
+            std::uint64_t bytes{ 0 };
+        };
+
+        inline AllocationCounters& allocationCounters() {
+            static thread_local AllocationCounters counters;
+            return counters;
         }
 
-        template<typename TFunc>
-        void forEach(TFunc f) {
-            while (iterator.hasNext()) {
-                f(iterator.next());
-            }
+        inline std::uint64_t allocationCount() {
+#ifdef STREAMS_COUNT_ALLOCATIONS
+            return allocationCounters().allocations;
+#else
+            return 0;
+#endif
         }
 
-        template<typename TFunc, typename TValue>
-        TValue reduce(TFunc f, TValue accu) {
-            while (iterator.hasNext()) {
-                accu = f(iterator.next(), accu);
-            }
+        inline std::uint64_t allocatedBytes() {
+#ifdef STREAMS_COUNT_ALLOCATIONS
+            return allocationCounters().bytes;
+#else
+            return 0;
+#endif
+        }
 
-            return accu;
+        template<typename>
+        inline constexpr bool countsAllocations =
+#ifdef STREAMS_COUNT_ALLOCATIONS
+            true;
+#else
+            false;
+#endif
+
+        // STREAMS_COUNT_ALLOCATIONS only reads the counters, so probe once that an operator new hook actually updates them.
+        inline bool allocationHooksActive() {
+            static const bool active = [] {
+                auto before = allocationCount();
+                ::operator delete(::operator new(1));
+                return allocationCount() != before;
+            }();
+            return active;
         }
 
-        template<typename TFunc>
-        bool allMatch(TFunc f) {
-            while (iterator.hasNext()) {
-                if (!f(iterator.next())) {
-                    return false;
-                }
+        template<typename T>
+        constexpr std::string_view typeName() {
+#if defined(__clang__) || defined(__GNUC__)
+            std::string_view name = __PRETTY_FUNCTION__;
+            auto begin = name.find("T = ");
+            begin = begin == std::string_view::npos ? 0 : begin + 4;
+#elif defined(_MSC_VER)
+            std::string_view name = __FUNCSIG__;
+            auto begin = name.find("typeName<");
+            begin = begin == std::string_view::npos ? 0 : begin + 9;
+            if (name.substr(begin, 6) == "class ") {
+                begin += 6;
             }
+#else
+            std::string_view name = "stage";
+            std::size_t begin = 0;
+#endif
+            auto end = name.find_first_of("<;]", begin);
+            return name.substr(begin, end == std::string_view::npos ? end : end - begin);
+        }
 
-            return true;
+        inline int countTrailingZeros(std::uint64_t x) {
+#ifdef _MSC_VER
+            unsigned long idx;
+            _BitScanForward64(&idx, x);
+            return static_cast<int>(idx);
+#else
+            return __builtin_ctzll(x);
+#endif
         }
 
-        template<typename TFunc>
-        bool anyMatch(TFunc f) {
-            while (iterator.hasNext()) {
-                if (f(iterator.next())) {
-                    return true;
+        // Yields the positions of JSON structural characters, classifying 64 bytes at a time
+        class StructuralScanner {
+            const char* begin;
+            const char* end;
+            const char* block;
+            std::uint64_t mask{ 0 };
+
+            static std::uint64_t classify(const char* ptr) {
+#if defined(__SSE2__) || defined(_M_X64)
+                std::uint64_t bits = 0;
+                for (int i = 0; i < 4; i++) {
+                    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i * 16));
+                    auto hits = _mm_or_si128(
+                        _mm_or_si128(
+                            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))),
+                            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')))),
+                        _mm_or_si128(
+                            _mm_cmpeq_epi8(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), _mm_set1_epi8('{')),
+                            _mm_cmpeq_epi8(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), _mm_set1_epi8('}'))));
+                    bits |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(hits))) << (i * 16);
+                }
+                return bits;
+#else
+                std::uint64_t bits = 0;
+                for (int i = 0; i < 64; i++) {
+                    switch (ptr[i]) {
+                    case '"': case '\\': case ':': case ',': case '{': case '}': case '[': case ']':
+                        bits |= std::uint64_t{ 1 } << i;
+                    }
                 }
+                return bits;
+#endif
             }
 
-            return false;
-        }
+            void loadBlock() {
+                if (end - block >= 64) {
+                    mask = classify(block);
+                    return;
+                }
 
-        /*template<typename TFunc>
-        auto firstMatch(TFunc f) {
-            while (iterator.hasNext()) {
-                auto x= iterator.next();
-                if (f(x)) {
-                    return Optional::of(x);
+                char padded[64]{};
+                std::memcpy(padded, block, static_cast<std::size_t>(end - block));
+                mask = classify(padded);
+            }
+
+        public:
+            StructuralScanner(const char* b, const char* e)
+                : begin{ b }, end{ e }, block{ b } {
+                if (block < end) {
+                    loadBlock();
                 }
             }
 
-            return Optional::empty();
-        }*/
+            const char* next() {
+                while (!mask) {
+                    block += 64;
+                    if (block >= end) {
+                        block = end;
+                        return end;
+                    }
+                    loadBlock();
+                }
 
-        int count() {
-            int ctr = 0;
-            while (iterator.hasNext()) {
-                iterator.next();
-                ctr++;
+                auto pos = block + countTrailingZeros(mask);
+                mask &= mask - 1;
+                return pos;
             }
 
-            return ctr;
-        }
+            void seek(const char* pos) {
+                if (pos >= end) {
+                    block = end;
+                    mask = 0;
+                    return;
+                }
 
-        template<typename TFunc>
-        int count(TFunc f) {
-            int ctr = 0;
-            while (iterator.hasNext()) {
-                if (f(iterator.next())) {
-                    ctr++;
+                auto blockStart = begin + ((pos - begin) / 64) * 64;
+                if (blockStart != block) {
+                    block = blockStart;
+                    loadBlock();
                 }
+
+                auto offset = pos - block;
+                mask &= offset < 64 ? ~((std::uint64_t{ 1 } << offset) - 1) : 0;
             }
 
-            return ctr;
-        }
+            const char* skipString() {
+                for (auto pos = next(); pos != end; pos = next()) {
+                    if (*pos == '"') {
+                        return pos;
+                    }
+                    if (*pos == '\\') {
+                        seek(pos + 2);
+                    }
+                }
+                return end;
+            }
 
-        template<typename TContainer>
-        void emplaceInto(TContainer& cont) {
-            while (iterator.hasNext()) {
-                cont.emplace_back(iterator.next());
+            const char* skipNested() {
+                int depth = 1;
+                for (auto pos = next(); pos != end; pos = next()) {
+                    switch (*pos) {
+                    case '"':
+                        if (skipString() == end) {
+                            return end;
+                        }
+                        break;
+                    case '{': case '[':
+                        depth++;
+                        break;
+                    case '}': case ']':
+                        if (--depth == 0) {
+                            return pos;
+                        }
+                        break;
+                    }
+                }
+                return end;
+            }
+
+            const char* getEnd() const {
+                return end;
             }
+        };
+
+        inline bool isJsonWhitespace(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
         }
-    };
 
+    }
 
     template<typename TIt>
-    class StreamIterator {
-        TIt current;
-        TIt end;
+    class EmptyStream;
 
-    public:
-        StreamIterator(TIt b, TIt e)
-            : current{b}, end{e} {}
+    template<typename TIt>
+    class VectorStream;
 
-        bool hasNext() {
-            return current != end;
-        }
+    template<typename TIt, std::size_t size>
+    class ArrayStream;
 
-        int estimateRemaining() {
-            return end - current;
-        }
+    template<typename TIt, typename TSentinel>
+    class RangeStream;
 
-        auto next() {
-            auto x = Detail::move(*current);
-            current++;
-            return x;
-        }
-    };
+    template<typename TRange>
+    class OwningRangeStream;
 
-    template<typename TIt>
-    class VectorStream : public Stream<StreamIterator<TIt>> {
-    public:
-        VectorStream(TIt b, TIt e)
-            : Stream<StreamIterator<TIt>>{ StreamIterator<TIt>{Detail::move(b), Detail::move(e)} } {}
-    };
+    class JsonLinesStream;
 
-    template<typename T>
-    class EmptyIterator {
+    class FileBlockStream;
 
-    public:
+    template<typename TResync>
+    class LinesStream;
 
-        bool hasNext() {
-            return false;
-        }
+    template<typename TSource, typename TStages, bool sized>
+    class ParallelStream;
 
-        int estimateRemaining() {
-            return 0;
-        }
+    template<typename TIt>
+    class ProfileIterator;
 
-        T next() {
-            throw Detail::Exception{};
-        }
-    };
+    struct ProfileReport;
 
-    template<typename T>
-    class EmptyStream : public Stream<EmptyIterator<T>> {
-    public:
-        EmptyStream()
-            : Stream<EmptyIterator<T>>{ EmptyIterator<T>{} } {}
-    };
+    class Executor;
 
+#ifdef STREAMS_HAS_POSIX
+    struct WriteOptions;
+#endif
 
-    template<typename TStreamIt, typename TLam>
-    class MapIterator {
-        TStreamIt it;
-        TLam lambda;
+    namespace Detail {
+        class MappedFile;
 
-    public:
-        MapIterator(TStreamIt i, TLam l)
-            : it{i}, lambda{l} {}
+        template<typename TIt>
+        class RangeSource;
 
-        bool hasNext() {
-            return it.hasNext();
-        }
+        template<typename TSource>
+        class TruncatedSource;
 
-        int estimateRemaining() {
-            return it.estimateRemaining();
-        }
+        template<typename T, typename TDist>
+        class RandomSource;
 
-        auto next() {
-            return lambda(it.next());
-        }
-    };
+        template<typename TIt>
+        auto profileSource(const TIt& it);
 
-    template<typename TStreamIt, typename TLam>
-    class MapStream : public Stream<MapIterator<TStreamIt, TLam>> {
-    public:
-        MapStream(TStreamIt i, TLam l)
-            : Stream<MapIterator<TStreamIt, TLam>>{ MapIterator<TStreamIt, TLam>{Detail::move(i), Detail::move(l)} } {}
-    };
+        template<typename TIt>
+        auto profileSource(const ProfileIterator<TIt>& it);
 
+        template<typename TIt, typename TUpstream>
+        auto profileStage(const TIt& it, const TUpstream& upstream);
 
-    template<typename TStreamIt, typename TLam>
-    class FlatMapIterator {
-        TStreamIt streamIt;
-        TLam lambda;
+        template<typename TIt>
+        void collectProfile(const TIt&, ProfileReport&);
 
-        using TInnerIt= Detail::removeReferenceType<decltype(lambda(streamIt.next()).getIterator())>;
-        Detail::TypedStorage<TInnerIt> innerIt;
-        bool hasValue{ false };
-        bool hasInnerIt{ false };
+        template<typename TIt>
+        void collectProfile(const ProfileIterator<TIt>& it, ProfileReport& report);
 
-        void moveNext() {
-            hasValue = false;
+        struct IdentityStage;
 
-            if (hasInnerIt && innerIt.get().hasNext()) {
-                hasValue = true;
-                return;
-            }
+        // Defined in streams_profile.h, streams_parallel.h and streams_io.h
+        template<typename TIt, typename TSink>
+        auto profileRun(const TIt& it, TSink sink);
 
-            while (streamIt.hasNext()) {
-                if (hasInnerIt) {
-                    innerIt.get()= Detail::move(lambda(streamIt.next()).getIterator());
+        template<typename TIt>
+        auto parallelStream(const TIt& it, std::shared_ptr<Executor> executor, int threads);
 
-                }
-                else {
-                    innerIt.construct( Detail::move(lambda(streamIt.next()).getIterator()) );
-                    hasInnerIt = true;
-                }
+#ifdef STREAMS_HAS_POSIX
+        template<typename TIt, typename TTarget, typename TFormat>
+        std::size_t writeStream(TIt& it, const TTarget& target, TFormat& format, const WriteOptions& options);
+#endif
+    }
 
-                if (innerIt.get().hasNext()) {
-                    hasValue = true;
-                    return;
-                }
-            }
+    template<typename TContainer>
+    STREAMS_CONSTEXPR auto of(TContainer& container) {
+        using TIt = decltype(std::begin(container));
+        using TSentinel = decltype(std::end(container));
+        if constexpr (std::is_same_v<TIt, TSentinel>) {
+            return VectorStream<TIt>{ std::begin(container), std::end(container) };
         }
-
-    public:
-        FlatMapIterator(TStreamIt i, TLam l)
-            : streamIt{ i }, lambda{ l } {
-            moveNext();
+        else {
+            return RangeStream<TIt, TSentinel>{ std::begin(container), std::end(container) };
         }
+    }
 
-        FlatMapIterator(const FlatMapIterator& x)
-            : streamIt{ x.streamIt }, lambda{ x.lambda }, hasValue{ x.hasValue }, hasInnerIt{ x.hasInnerIt } {
+    template<typename TRange, typename = std::enable_if_t<!std::is_lvalue_reference_v<TRange>>>
+    auto of(TRange&& range) {
+        return OwningRangeStream<TRange>{ std::make_shared<TRange>(Detail::move(range)) };
+    }
+
+    template<typename T>
+    STREAMS_CONSTEXPR auto of(T* begin, T* end) {
+        return VectorStream<T*>{ begin, end };
+    }
+
+    template<typename T>
+    STREAMS_CONSTEXPR auto of(const T* begin, const T* end) {
+        return VectorStream<const T*>{ begin, end };
+    }
+
+    template<typename T, std::size_t size>
+    STREAMS_CONSTEXPR auto of(T(&data)[size]) {
+        return ArrayStream<T*, size>{ data };
+    }
+
+    template<typename T, std::size_t size>
+    STREAMS_CONSTEXPR auto of(const T(&data)[size]) {
+        return ArrayStream<const T*, size>{ data };
+    }
+
+    template<typename T, std::size_t size>
+    STREAMS_CONSTEXPR auto of(std::array<T, size>& data) {
+        return ArrayStream<T*, size>{ data.data() };
+    }
+
+    template<typename T, std::size_t size>
+    STREAMS_CONSTEXPR auto of(const std::array<T, size>& data) {
+        return ArrayStream<const T*, size>{ data.data() };
+    }
+
+    template<typename T>
+    STREAMS_CONSTEXPR auto empty() {
+        return EmptyStream<T>{};
+    }
+
+    namespace Detail {
+
+        template<typename TStreamIt>
+        class ForwardingIterator {
+        protected:
+            TStreamIt it;
+
+        public:
+            static constexpr std::size_t extent = extentOf<TStreamIt>;
+
+            STREAMS_CONSTEXPR ForwardingIterator(TStreamIt i)
+                : it{ Detail::move(i) } {}
+
+            STREAMS_CONSTEXPR bool hasNext() {
+                return it.hasNext();
+            }
+
+            STREAMS_CONSTEXPR int estimateRemaining() {
+                return it.estimateRemaining();
+            }
+
+            template<typename T = TStreamIt>
+            STREAMS_CONSTEXPR auto size() const -> decltype(std::declval<const T&>().size()) {
+                return it.size();
+            }
+        };
+    }
+
+    template<typename TStreamIt, typename TLam>
+    class MapIterator : public Detail::ForwardingIterator<TStreamIt> {
+        TLam lambda;
+
+    public:
+        STREAMS_CONSTEXPR MapIterator(TStreamIt i, TLam l)
+            : Detail::ForwardingIterator<TStreamIt>{ Detail::move(i) }, lambda{ l } {}
+
+        STREAMS_CONSTEXPR auto next() {
+            return lambda(this->it.next());
+        }
+
+        template<typename T = TStreamIt>
+        STREAMS_CONSTEXPR auto at(std::size_t idx) const -> decltype(std::declval<const TLam&>()(std::declval<const T&>().at(idx))) {
+            return lambda(this->it.at(idx));
+        }
+    };
+
+    template<typename TStreamIt, typename TLam>
+    class FlatMapIterator {
+        TStreamIt streamIt;
+        TLam lambda;
+
+        using TInnerIt= Detail::removeReferenceType<decltype(lambda(streamIt.next()).getIterator())>;
+        Detail::TypedStorage<TInnerIt> innerIt;
+        bool hasValue{ false };
+        bool hasInnerIt{ false };
+        bool needsSearch{ true };
+
+        STREAMS_CONSTEXPR void moveNext() {
+            hasValue = false;
+
+            if (hasInnerIt && innerIt.get().hasNext()) {
+                hasValue = true;
+                return;
+            }
+
+            while (streamIt.hasNext()) {
+                if (hasInnerIt) {
+                    innerIt.get()= Detail::move(lambda(streamIt.next()).getIterator());
+
+                }
+                else {
+                    innerIt.construct( Detail::move(lambda(streamIt.next()).getIterator()) );
+                    hasInnerIt = true;
+                }
+
+                if (innerIt.get().hasNext()) {
+                    hasValue = true;
+                    return;
+                }
+            }
+        }
+
+    public:
+        STREAMS_CONSTEXPR FlatMapIterator(TStreamIt i, TLam l)
+            : streamIt{ i }, lambda{ l } {}
+
+        STREAMS_CONSTEXPR FlatMapIterator(const FlatMapIterator& x)
+            : streamIt{ x.streamIt }, lambda{ x.lambda }, hasValue{ x.hasValue }, hasInnerIt{ x.hasInnerIt }, needsSearch{ x.needsSearch } {
             if (x.hasInnerIt) {
                 innerIt.construct(x.innerIt.get());
             }
         }
 
-        FlatMapIterator(FlatMapIterator&& x)
-            : streamIt{ Detail::move(x.streamIt) }, lambda{ Detail::move(x.lambda) }, hasValue{ x.hasValue }, hasInnerIt{ x.hasInnerIt } {
+        STREAMS_CONSTEXPR FlatMapIterator(FlatMapIterator&& x)
+            : streamIt{ Detail::move(x.streamIt) }, lambda{ Detail::move(x.lambda) }, hasValue{ x.hasValue }, hasInnerIt{ x.hasInnerIt }, needsSearch{ x.needsSearch } {
             if (x.hasInnerIt) {
                 innerIt.construct(Detail::move(x.innerIt.get()));
             }
         }
 
-        ~FlatMapIterator() {
+        STREAMS_CONSTEXPR ~FlatMapIterator() {
             if (hasInnerIt) {
                 innerIt.destruct();
             }
         }
 
-        bool hasNext() {
+        STREAMS_CONSTEXPR bool hasNext() {
+            if (needsSearch) {
+                moveNext();
+                needsSearch = false;
+            }
             return hasValue;
         }
 
-        int estimateRemaining() {
+        STREAMS_CONSTEXPR int estimateRemaining() {
             return streamIt.estimateRemaining();
         }
 
-        auto next() {
-            auto x= innerIt.get().next();
-            moveNext();
-
-            return x;
+        STREAMS_CONSTEXPR auto next() {
+            hasNext();
+            needsSearch = true;
+            return innerIt.get().next();
         }
     };
 
     template<typename TStreamIt, typename TLam>
-    class FlatMapStream : public Stream<FlatMapIterator<TStreamIt, TLam>> {
-    public:
-        FlatMapStream(TStreamIt i, TLam l)
-            : Stream<FlatMapIterator<TStreamIt, TLam>>{ FlatMapIterator<TStreamIt, TLam>{Detail::move(i), Detail::move(l)} } {}
-    };
-
-
-    template<typename TStreamIt, typename TLam>
-    class TapIterator {
-        TStreamIt it;
+    class TapIterator : public Detail::ForwardingIterator<TStreamIt> {
         TLam lambda;
 
     public:
-        TapIterator(TStreamIt i, TLam l)
-            : it{ i }, lambda{ l } {}
-
-        bool hasNext() {
-            return it.hasNext();
-        }
-
-        int estimateRemaining() {
-            return it.estimateRemaining();
-        }
+        STREAMS_CONSTEXPR TapIterator(TStreamIt i, TLam l)
+            : Detail::ForwardingIterator<TStreamIt>{ Detail::move(i) }, lambda{ l } {}
 
-        auto next() {
-            auto x = it.next();
+        STREAMS_CONSTEXPR auto next() {
+            auto x = this->it.next();
             lambda(x);
             return x;
         }
     };
 
-
-    template<typename TStreamIt, typename TLam>
-    class TapStream : public Stream<TapIterator<TStreamIt, TLam>> {
-    public:
-        TapStream(TStreamIt i, TLam l)
-            : Stream<TapIterator<TStreamIt, TLam>>{ TapIterator<TStreamIt, TLam>{Detail::move(i), Detail::move(l)} } {}
-    };
-
     template<typename TStreamIt>
     class LimitIterator {
         TStreamIt it;
@@ -448,31 +839,66 @@
         int idx;
 
     public:
-        LimitIterator(TStreamIt i, int s)
+        STREAMS_CONSTEXPR LimitIterator(TStreamIt i, int s)
             : it{ i }, size{ s }, idx{ 0 } {}
 
-        bool hasNext() {
+        STREAMS_CONSTEXPR bool hasNext() {
             return  idx < size&& it.hasNext();
         }
 
-        int estimateRemaining() {
+        STREAMS_CONSTEXPR int estimateRemaining() {
             int rem = it.estimateRemaining();
             return rem < (size - idx) ? rem : (size - idx);
         }
 
-        auto next() {
+        STREAMS_CONSTEXPR auto next() {
             idx++;
             return it.next();
         }
+
+        template<typename T = TStreamIt, typename TSource = decltype(std::declval<const T&>().source()), typename = std::enable_if_t<TSource::sized>>
+        auto source() const {
+            return Detail::TruncatedSource<TSource>{ it.source(), static_cast<std::uint64_t>(size - idx) };
+        }
     };
 
     template<typename TStreamIt>
-    class LimitStream : public Stream<LimitIterator<TStreamIt>> {
+    class NoAllocIterator : public Detail::ForwardingIterator<TStreamIt> {
+        std::uint64_t start{ 0 };
+        bool started{ false };
+
+        void begin() {
+            if (!started) {
+                start = Detail::allocationCount();
+                started = true;
+            }
+        }
+
+        void check() {
+            auto allocations = Detail::allocationCount() - start;
+            if (allocations) {
+                throw Detail::AllocationError{ allocations };
+            }
+        }
+
     public:
-        LimitStream(TStreamIt i, int s)
-            : Stream<LimitIterator<TStreamIt>>{ LimitIterator<TStreamIt>{Detail::move(i), s} } {}
-    };
+        NoAllocIterator(TStreamIt i)
+            : Detail::ForwardingIterator<TStreamIt>{ Detail::move(i) } {}
 
+        bool hasNext() {
+            begin();
+            bool result = this->it.hasNext();
+            check();
+            return result;
+        }
+
+        auto next() {
+            begin();
+            auto x = this->it.next();
+            check();
+            return x;
+        }
+    };
 
     template<typename TStreamIt, typename TLam>
     class FilterIterator {
@@ -483,9 +909,10 @@
 
         bool hasValue{ false };
         bool hasInit{ false };
+        bool needsSearch{ true };
         Detail::TypedStorage<TValue> currentValue;
 
-        void moveNext() {
+        STREAMS_CONSTEXPR void moveNext() {
             hasValue = false;
             while (it.hasNext()) {
                 auto x = Detail::move( it.next() );
@@ -495,7 +922,7 @@
                         hasInit = true;
                     }
                     else {
-                        currentValue.get() = x;
+                        currentValue.get() = Detail::move(x);
                     }
                     hasValue = true;
                     return;
@@ -504,50 +931,1694 @@
         }
 
     public:
-        FilterIterator(TStreamIt i, TLam l)
-            : it(i), lambda(l) {
-            moveNext();
-        }
+        STREAMS_CONSTEXPR FilterIterator(TStreamIt i, TLam l)
+            : it(i), lambda(l) {}
 
-        FilterIterator(const FilterIterator& x)
-            : it(x.it), lambda(x.lambda), hasValue(x.hasValue), hasInit(x.hasInit) {
+        STREAMS_CONSTEXPR FilterIterator(const FilterIterator& x)
+            : it(x.it), lambda(x.lambda), hasValue(x.hasValue), hasInit(x.hasInit), needsSearch(x.needsSearch) {
             if (hasInit) {
                 currentValue.construct(x.currentValue.get());
             }
         }
 
-        FilterIterator(FilterIterator&& x)
-            : it(Detail::move(x.it)), lambda(Detail::move(x.lambda)), hasValue(x.hasValue), hasInit(x.hasInit) {
+        STREAMS_CONSTEXPR FilterIterator(FilterIterator&& x)
+            : it(Detail::move(x.it)), lambda(Detail::move(x.lambda)), hasValue(x.hasValue), hasInit(x.hasInit), needsSearch(x.needsSearch) {
             if (hasInit) {
                 currentValue.construct(Detail::move(x.currentValue.get()));
             }
         }
 
-        ~FilterIterator() {
+        STREAMS_CONSTEXPR ~FilterIterator() {
             if (hasInit) {
                 currentValue.destruct();
             }
         }
 
-        int estimateRemaining() {
+        STREAMS_CONSTEXPR int estimateRemaining() {
             return it.estimateRemaining();
         }
 
+        STREAMS_CONSTEXPR bool hasNext() {
+            if (needsSearch) {
+                moveNext();
+                needsSearch = false;
+            }
+            return hasValue;
+        }
+
+        STREAMS_CONSTEXPR auto next() {
+            hasNext();
+            needsSearch = true;
+            return Detail::move(currentValue.get());
+        }
+    };
+
+    template<typename TStreamIt, typename TParser, typename TSink>
+    class ParseIterator {
+        TStreamIt it;
+        TSink sink;
+
+        using TValue = typename TParser::Type;
+
+        bool hasValue{ false };
+        TValue currentValue{};
+
+        void moveNext() {
+            hasValue = false;
+            while (it.hasNext()) {
+                auto x = it.next();
+                std::string_view str{ x };
+                auto error = TParser{}(str, currentValue);
+                if (error == std::errc{}) {
+                    hasValue = true;
+                    return;
+                }
+                sink(str, error);
+            }
+        }
+
+    public:
+        ParseIterator(TStreamIt i, TSink s)
+            : it{ i }, sink{ s } {
+            moveNext();
+        }
+
         bool hasNext() {
             return hasValue;
         }
 
+        int estimateRemaining() {
+            return it.estimateRemaining();
+        }
+
         auto next() {
-            auto x = currentValue.get();
+            auto x = currentValue;
             moveNext();
             return x;
         }
     };
 
-    template<typename TStreamIt, typename TLam>
-    class FilterStream : public Stream<FilterIterator<TStreamIt, TLam>> {
+    template<typename TStreamIt, typename TParser, typename TSink>
+    class ParseFieldsIterator {
+        static constexpr int batchSize = 16;
+
+        TStreamIt it;
+        TSink sink;
+        char delimiter;
+
+        using TLine = decltype(it.next());
+        using TValue = typename TParser::Type;
+
+        TLine line{};
+        std::size_t offset{ 0 };
+        bool hasLine{ false };
+
+        TValue values[batchSize]{};
+        int valueCount{ 0 };
+        int valueIdx{ 0 };
+
+        void parseBatch() {
+            std::string_view str{ line };
+            valueCount = 0;
+            valueIdx = 0;
+
+            while (hasLine && valueCount < batchSize) {
+                auto end = str.find(delimiter, offset);
+                auto field = str.substr(offset, end == std::string_view::npos ? end : end - offset);
+                if (end == std::string_view::npos) {
+                    hasLine = false;
+                }
+                else {
+                    offset = end + 1;
+                }
+
+                auto error = TParser{}(field, values[valueCount]);
+                if (error == std::errc{}) {
+                    valueCount++;
+                }
+                else {
+                    sink(field, error);
+                }
+            }
+        }
+
+        void moveNext() {
+            while (valueIdx >= valueCount) {
+                if (!hasLine) {
+                    if (!it.hasNext()) {
+                        return;
+                    }
+                    line = it.next();
+                    offset = 0;
+                    hasLine = true;
+                }
+                parseBatch();
+            }
+        }
+
+    public:
+        ParseFieldsIterator(TStreamIt i, char d, TSink s)
+            : it{ i }, sink{ s }, delimiter{ d } {
+            moveNext();
+        }
+
+        bool hasNext() {
+            return valueIdx < valueCount;
+        }
+
+        int estimateRemaining() {
+            return (valueCount - valueIdx) + it.estimateRemaining();
+        }
+
+        auto next() {
+            auto x = values[valueIdx++];
+            moveNext();
+            return x;
+        }
+    };
+
+    template<typename TFirstIt, typename TSecondIt, typename TLam>
+    class ZipIterator {
+        TFirstIt first;
+        TSecondIt second;
+        TLam lambda;
+
+    public:
+        static constexpr std::size_t extent = Detail::extentOf<TFirstIt> == Detail::extentOf<TSecondIt> ? Detail::extentOf<TFirstIt> : dynamicExtent;
+
+        STREAMS_CONSTEXPR ZipIterator(TFirstIt a, TSecondIt b, TLam l)
+            : first{ Detail::move(a) }, second{ Detail::move(b) }, lambda{ l } {}
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return first.hasNext() && second.hasNext();
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            int a = first.estimateRemaining();
+            int b = second.estimateRemaining();
+            return a < b ? a : b;
+        }
+
+        STREAMS_CONSTEXPR auto next() {
+            auto a = first.next();
+            return lambda(Detail::move(a), second.next());
+        }
+
+        template<typename T = TFirstIt, typename U = TSecondIt>
+        STREAMS_CONSTEXPR auto at(std::size_t idx) const -> decltype(std::declval<const TLam&>()(std::declval<const T&>().at(idx), std::declval<const U&>().at(idx))) {
+            auto a = first.at(idx);
+            return lambda(Detail::move(a), second.at(idx));
+        }
+
+        template<typename T = TFirstIt, typename U = TSecondIt>
+        STREAMS_CONSTEXPR auto size() const -> decltype(std::declval<const T&>().size() + std::declval<const U&>().size()) {
+            auto a = first.size();
+            auto b = second.size();
+            return a < b ? a : b;
+        }
+    };
+
+    template<typename TStreamIt>
+    class ReverseIterator {
+        TStreamIt it;
+        std::size_t remaining;
+
     public:
-        FilterStream(TStreamIt i, TLam l)
-            : Stream<FilterIterator<TStreamIt, TLam>>{ FilterIterator<TStreamIt, TLam>{Detail::move(i), Detail::move(l)} } {}
+        static constexpr std::size_t extent = Detail::extentOf<TStreamIt>;
+
+        STREAMS_CONSTEXPR ReverseIterator(TStreamIt i)
+            : it{ Detail::move(i) }, remaining{ it.size() } {}
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return remaining > 0;
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            return static_cast<int>(remaining);
+        }
+
+        STREAMS_CONSTEXPR auto next() {
+            return it.at(--remaining);
+        }
+
+        STREAMS_CONSTEXPR auto at(std::size_t idx) const {
+            return it.at(remaining - 1 - idx);
+        }
+
+        STREAMS_CONSTEXPR std::size_t size() const {
+            return remaining;
+        }
     };
-}
\ No newline at end of file
+
+    namespace Detail {
+
+        template<typename TRange>
+        using RangeIteratorOf = decltype(std::begin(std::declval<TRange&>()));
+
+        template<typename TRange>
+        using RangeSentinelOf = decltype(std::end(std::declval<TRange&>()));
+
+        template<typename TIt, typename TSentinel, typename = void>
+        struct IsSizedSentinel : std::false_type {};
+
+        template<typename TIt, typename TSentinel>
+        struct IsSizedSentinel<TIt, TSentinel, std::void_t<decltype(std::declval<const TSentinel&>() - std::declval<const TIt&>())>> : std::true_type {};
+
+        template<typename TIt, typename TSentinel>
+        inline constexpr bool isSizedSentinel = IsSizedSentinel<TIt, TSentinel>::value;
+
+        template<typename TIt, typename = void>
+        struct IsRandomAccess : std::false_type {};
+
+        template<typename TIt>
+        struct IsRandomAccess<TIt, std::void_t<decltype(std::declval<const TIt&>().at(0)), decltype(std::declval<const TIt&>().size())>> : std::true_type {};
+
+        template<typename TIt>
+        inline constexpr bool isRandomAccess = IsRandomAccess<TIt>::value;
+
+        template<typename TIt>
+        class InputRangeIterator {
+        public:
+            using value_type = decltype(std::declval<TIt&>().next());
+            using difference_type = std::ptrdiff_t;
+            using reference = value_type&;
+            using pointer = value_type*;
+            using iterator_category = std::input_iterator_tag;
+
+        private:
+            TIt* it{ nullptr };
+            std::optional<value_type> current;
+
+            void advance() {
+                if (it->hasNext()) {
+                    current.emplace(it->next());
+                }
+                else {
+                    current.reset();
+                }
+            }
+
+        public:
+            InputRangeIterator() = default;
+
+            InputRangeIterator(TIt* i)
+                : it{ i } {
+                advance();
+            }
+
+            reference operator*() const {
+                return const_cast<reference>(*current);
+            }
+
+            pointer operator->() const {
+                return &**this;
+            }
+
+            InputRangeIterator& operator++() {
+                advance();
+                return *this;
+            }
+
+            void operator++(int) {
+                advance();
+            }
+
+            friend bool operator==(const InputRangeIterator& a, const InputRangeIterator& b) {
+                return a.current.has_value() == b.current.has_value();
+            }
+
+            friend bool operator!=(const InputRangeIterator& a, const InputRangeIterator& b) {
+                return a.current.has_value() != b.current.has_value();
+            }
+        };
+
+        template<typename TIt>
+        class ViewIterator {
+        public:
+            using reference = decltype(std::declval<const TIt&>().at(0));
+            using value_type = std::remove_cv_t<std::remove_reference_t<reference>>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using iterator_category = std::conditional_t<std::is_reference_v<reference>, std::random_access_iterator_tag, std::input_iterator_tag>;
+            using iterator_concept = std::random_access_iterator_tag;
+
+        private:
+            const TIt* it{ nullptr };
+            difference_type idx{ 0 };
+
+        public:
+            ViewIterator() = default;
+
+            ViewIterator(const TIt* i, difference_type x)
+                : it{ i }, idx{ x } {}
+
+            reference operator*() const {
+                return it->at(static_cast<std::size_t>(idx));
+            }
+
+            reference operator[](difference_type offset) const {
+                return it->at(static_cast<std::size_t>(idx + offset));
+            }
+
+            ViewIterator& operator++() {
+                idx++;
+                return *this;
+            }
+
+            ViewIterator operator++(int) {
+                auto copy = *this;
+                idx++;
+                return copy;
+            }
+
+            ViewIterator& operator--() {
+                idx--;
+                return *this;
+            }
+
+            ViewIterator operator--(int) {
+                auto copy = *this;
+                idx--;
+                return copy;
+            }
+
+            ViewIterator& operator+=(difference_type offset) {
+                idx += offset;
+                return *this;
+            }
+
+            ViewIterator& operator-=(difference_type offset) {
+                idx -= offset;
+                return *this;
+            }
+
+            friend ViewIterator operator+(ViewIterator a, difference_type offset) {
+                return a += offset;
+            }
+
+            friend ViewIterator operator+(difference_type offset, ViewIterator a) {
+                return a += offset;
+            }
+
+            friend ViewIterator operator-(ViewIterator a, difference_type offset) {
+                return a -= offset;
+            }
+
+            friend difference_type operator-(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx - b.idx;
+            }
+
+            friend bool operator==(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx == b.idx;
+            }
+
+            friend bool operator!=(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx != b.idx;
+            }
+
+            friend bool operator<(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx < b.idx;
+            }
+
+            friend bool operator>(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx > b.idx;
+            }
+
+            friend bool operator<=(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx <= b.idx;
+            }
+
+            friend bool operator>=(const ViewIterator& a, const ViewIterator& b) {
+                return a.idx >= b.idx;
+            }
+        };
+    }
+
+    template<typename TIt>
+    class RandomAccessView {
+        TIt it;
+
+    public:
+        using iterator = Detail::ViewIterator<TIt>;
+        using const_iterator = iterator;
+        using value_type = typename iterator::value_type;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+
+        RandomAccessView(TIt i)
+            : it{ Detail::move(i) } {}
+
+        iterator begin() const {
+            return { &it, 0 };
+        }
+
+        iterator end() const {
+            return { &it, static_cast<difference_type>(it.size()) };
+        }
+
+        std::size_t size() const {
+            return it.size();
+        }
+
+        bool empty() const {
+            return it.size() == 0;
+        }
+
+        decltype(auto) operator[](std::size_t idx) const {
+            return it.at(idx);
+        }
+    };
+
+    template<typename TIt>
+    class Stream {
+    protected:
+        using TIterator = TIt;
+
+    public:
+        static constexpr std::size_t extent = Detail::extentOf<TIt>;
+
+    protected:
+        TIterator iterator;
+
+        STREAMS_CONSTEXPR auto upstream() {
+#ifdef STREAMS_ENABLE_PROFILING
+            return Detail::profileSource(iterator);
+#else
+            return iterator;
+#endif
+        }
+
+        template<typename TNext, typename TUpstream>
+        STREAMS_CONSTEXPR static auto profiled(TNext next, const TUpstream& upstreamIt) {
+#ifdef STREAMS_ENABLE_PROFILING
+            return Detail::profileStage(next, upstreamIt);
+#else
+            (void)upstreamIt;
+            return Stream<TNext>{ Detail::move(next) };
+#endif
+        }
+
+        STREAMS_CONSTEXPR bool unconsumed() {
+            return extent != dynamicExtent && static_cast<std::size_t>(iterator.estimateRemaining()) == extent;
+        }
+
+    public:
+        STREAMS_CONSTEXPR Stream(TIterator it)
+            : iterator{ Detail::move(it) } {}
+
+        STREAMS_CONSTEXPR auto& getIterator() {
+            return iterator;
+        }
+
+        auto begin() {
+            return Detail::InputRangeIterator<TIterator>{ &iterator };
+        }
+
+        auto end() {
+            return Detail::InputRangeIterator<TIterator>{};
+        }
+
+        template<typename T = TIterator>
+        auto view() {
+            static_assert(Detail::isRandomAccess<T>, "view() requires a sized random-access source followed only by map(), zip() or reverse() stages");
+            return RandomAccessView<TIterator>{ iterator };
+        }
+
+        template<typename TLam>
+        STREAMS_CONSTEXPR auto map(TLam lambda) {
+            auto it = upstream();
+            return profiled(MapIterator<decltype(it), TLam>{ it, lambda }, it);
+        }
+
+        template<typename TLam>
+        STREAMS_CONSTEXPR auto flatMap(TLam lambda) {
+            auto it = upstream();
+            return profiled(FlatMapIterator<decltype(it), TLam>{ it, lambda }, it);
+        }
+
+        template<typename TLam>
+        STREAMS_CONSTEXPR auto filter(TLam lambda) {
+            auto it = upstream();
+            return profiled(FilterIterator<decltype(it), TLam>{ it, lambda }, it);
+        }
+
+        template<typename TLam>
+        STREAMS_CONSTEXPR auto tap(TLam lambda) {
+            auto it = upstream();
+            return profiled(TapIterator<decltype(it), TLam>{ it, lambda }, it);
+        }
+
+        template<typename TOtherIt, typename TLam = Detail::MakePair>
+        STREAMS_CONSTEXPR auto zip(Stream<TOtherIt> other, TLam lambda = {}) {
+            constexpr auto otherExtent = Detail::extentOf<TOtherIt>;
+            static_assert(extent == dynamicExtent || otherExtent == dynamicExtent || extent == otherExtent,
+                "zip() of two static-extent streams requires equal sizes");
+
+            auto it = upstream();
+            return profiled(ZipIterator<decltype(it), TOtherIt, TLam>{ it, Detail::move(other.getIterator()), lambda }, it);
+        }
+
+        STREAMS_CONSTEXPR auto limit(int size) {
+            auto it = upstream();
+            return profiled(LimitIterator<decltype(it)>{ it, size }, it);
+        }
+
+        template<typename T = TIterator>
+        STREAMS_CONSTEXPR auto reverse() {
+            static_assert(Detail::isRandomAccess<T>, "reverse() requires a sized random-access source followed only by map(), zip() or reverse() stages");
+
+            auto it = upstream();
+            return profiled(ReverseIterator<decltype(it)>{ it }, it);
+        }
+
+        template<typename T = TIterator>
+        auto assertNoAlloc() {
+            static_assert(Detail::countsAllocations<T>, "assertNoAlloc() requires STREAMS_COUNT_ALLOCATIONS and an operator new hook, e.g. STREAMS_DEFINE_ALLOCATION_HOOKS in one translation unit");
+            if (!Detail::allocationHooksActive()) {
+                throw Detail::AllocationError{ 0 };
+            }
+
+            auto it = upstream();
+            return profiled(NoAllocIterator<decltype(it)>{ it }, it);
+        }
+
+        template<typename T, typename TSink = Detail::IgnoreParseErrors>
+        auto parseInts(TSink sink = {}) {
+            auto it = upstream();
+            return profiled(ParseIterator<decltype(it), Detail::FromCharsParser<T>, TSink>{ it, sink }, it);
+        }
+
+        template<typename TSink = Detail::IgnoreParseErrors>
+        auto parseDoubles(TSink sink = {}) {
+            auto it = upstream();
+            return profiled(ParseIterator<decltype(it), Detail::FromCharsParser<double>, TSink>{ it, sink }, it);
+        }
+
+        template<typename T, int digits, typename TSink = Detail::IgnoreParseErrors>
+        auto parseFixedInts(TSink sink = {}) {
+            auto it = upstream();
+            return profiled(ParseIterator<decltype(it), Detail::FixedWidthParser<T, digits>, TSink>{ it, sink }, it);
+        }
+
+        template<typename T, typename TSink = Detail::IgnoreParseErrors>
+        auto parseIntFields(char delimiter, TSink sink = {}) {
+            auto it = upstream();
+            return profiled(ParseFieldsIterator<decltype(it), Detail::FromCharsParser<T>, TSink>{ it, delimiter, sink }, it);
+        }
+
+        template<typename TSink = Detail::IgnoreParseErrors>
+        auto parseDoubleFields(char delimiter, TSink sink = {}) {
+            auto it = upstream();
+            return profiled(ParseFieldsIterator<decltype(it), Detail::FromCharsParser<double>, TSink>{ it, delimiter, sink }, it);
+        }
+
+        STREAMS_CONSTEXPR void sink() {
+            if constexpr (extent <= STREAMS_MAX_UNROLL) {
+                if (unconsumed()) {
+                    Detail::unroll([&]() { iterator.next(); }, std::make_index_sequence<extent>{});
+                    return;
+                }
+            }
+
+            while (iterator.hasNext()) {
+                iterator.next();
+            }
+        }
+
+        auto profile() {
+            return Detail::profileRun(iterator, [this]() { sink(); });
+        }
+
+        template<typename TFunc>
+        STREAMS_CONSTEXPR void forEach(TFunc f) {
+            if constexpr (extent <= STREAMS_MAX_UNROLL) {
+                if (unconsumed()) {
+                    Detail::unroll([&]() { f(iterator.next()); }, std::make_index_sequence<extent>{});
+                    return;
+                }
+            }
+
+            while (iterator.hasNext()) {
+                f(iterator.next());
+            }
+        }
+
+        template<typename TFunc, typename TValue>
+        STREAMS_CONSTEXPR TValue reduce(TFunc f, TValue accu) {
+            if constexpr (extent <= STREAMS_MAX_UNROLL) {
+                if (unconsumed()) {
+                    Detail::unroll([&]() { accu = f(iterator.next(), accu); }, std::make_index_sequence<extent>{});
+                    return accu;
+                }
+            }
+
+            while (iterator.hasNext()) {
+                accu = f(iterator.next(), accu);
+            }
+
+            return accu;
+        }
+
+        template<typename TFunc>
+        STREAMS_CONSTEXPR bool allMatch(TFunc f) {
+            while (iterator.hasNext()) {
+                if (!f(iterator.next())) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        template<typename TFunc>
+        STREAMS_CONSTEXPR bool anyMatch(TFunc f) {
+            while (iterator.hasNext()) {
+                if (f(iterator.next())) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        template<typename TFunc>
+        STREAMS_CONSTEXPR auto findFirst(TFunc f) {
+            using TValue = decltype(iterator.next());
+            while (iterator.hasNext()) {
+                auto x = iterator.next();
+                if (f(x)) {
+                    return std::optional<TValue>{ Detail::move(x) };
+                }
+            }
+
+            return std::optional<TValue>{};
+        }
+
+        STREAMS_CONSTEXPR int count() {
+            int ctr = 0;
+            while (iterator.hasNext()) {
+                iterator.next();
+                ctr++;
+            }
+
+            return ctr;
+        }
+
+        template<typename TFunc>
+        STREAMS_CONSTEXPR int count(TFunc f) {
+            int ctr = 0;
+            while (iterator.hasNext()) {
+                if (f(iterator.next())) {
+                    ctr++;
+                }
+            }
+
+            return ctr;
+        }
+
+        template<typename T = TIterator>
+        double sumPrecise() {
+            static_assert(std::is_convertible_v<decltype(std::declval<T&>().next()), double>, "sumPrecise() requires a stream of arithmetic values");
+
+            Detail::PreciseSum sum;
+            sum.addAll(iterator);
+            return sum.result();
+        }
+
+        template<typename TContainer>
+        STREAMS_CONSTEXPR void emplaceInto(TContainer& cont) {
+            while (iterator.hasNext()) {
+                cont.emplace_back(iterator.next());
+            }
+        }
+
+        STREAMS_CONSTEXPR auto get(std::size_t idx) {
+            if constexpr (Detail::isRandomAccess<TIterator>) {
+                if (idx >= iterator.size()) {
+                    throw Detail::Exception{};
+                }
+                return iterator.at(idx);
+            }
+            else {
+                for (; idx > 0 && iterator.hasNext(); idx--) {
+                    iterator.next();
+                }
+                if (!iterator.hasNext()) {
+                    throw Detail::Exception{};
+                }
+                return iterator.next();
+            }
+        }
+
+        STREAMS_CONSTEXPR auto last() {
+            if constexpr (Detail::isRandomAccess<TIterator>) {
+                auto size = iterator.size();
+                if (size == 0) {
+                    throw Detail::Exception{};
+                }
+                return iterator.at(size - 1);
+            }
+            else {
+                if (!iterator.hasNext()) {
+                    throw Detail::Exception{};
+                }
+                auto x = iterator.next();
+                while (iterator.hasNext()) {
+                    x = iterator.next();
+                }
+                return x;
+            }
+        }
+
+        template<std::size_t size = extent>
+        STREAMS_CONSTEXPR auto toArray() {
+            static_assert(size != dynamicExtent, "toArray() requires a stream with static extent");
+
+            if constexpr (size <= STREAMS_MAX_UNROLL && size <= extent) {
+                if (unconsumed()) {
+                    return Detail::collectArray(iterator, std::make_index_sequence<size>{});
+                }
+            }
+
+            std::array<decltype(iterator.next()), size> result{};
+            for (auto& x : result) {
+                if (!iterator.hasNext()) {
+                    throw Detail::Exception{};
+                }
+                x = iterator.next();
+            }
+            return result;
+        }
+
+        template<typename TFunc>
+        auto groupBy(TFunc keyFn) {
+            using TValue = decltype(iterator.next());
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+
+            std::unordered_map<TKey, std::vector<TValue>> groups;
+            while (iterator.hasNext()) {
+                auto x = iterator.next();
+                groups[keyFn(x)].emplace_back(Detail::move(x));
+            }
+
+            return groups;
+        }
+
+        auto distinct() {
+            using TValue = decltype(iterator.next());
+
+            std::unordered_set<TValue> seen;
+            std::vector<TValue> values;
+            while (iterator.hasNext()) {
+                auto x = iterator.next();
+                if (seen.insert(x).second) {
+                    values.emplace_back(Detail::move(x));
+                }
+            }
+
+            return values;
+        }
+
+        template<typename TFunc>
+        auto countBy(TFunc keyFn) {
+            using TValue = decltype(iterator.next());
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+
+            std::unordered_map<TKey, std::uint64_t> counts;
+            while (iterator.hasNext()) {
+                auto x = iterator.next();
+                counts[keyFn(x)]++;
+            }
+
+            return counts;
+        }
+
+        template<typename TKeyFunc, typename TValueFunc>
+        auto sumBy(TKeyFunc keyFn, TValueFunc valueFn) {
+            using TValue = decltype(iterator.next());
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+            using TSum = std::decay_t<decltype(valueFn(std::declval<TValue&>()))>;
+
+            std::unordered_map<TKey, TSum> sums;
+            while (iterator.hasNext()) {
+                auto x = iterator.next();
+                sums[keyFn(x)] += valueFn(x);
+            }
+
+            return sums;
+        }
+
+        auto parallel(std::shared_ptr<Executor> executor, int threads = 0) {
+            return Detail::parallelStream(iterator, Detail::move(executor), threads);
+        }
+
+        auto parallel(Executor& executor, int threads = 0) {
+            return parallel(std::shared_ptr<Executor>{ std::shared_ptr<Executor>{}, &executor }, threads);
+        }
+
+        auto parallel(int threads = 0) {
+            return parallel(std::shared_ptr<Executor>{}, threads);
+        }
+
+#ifdef STREAMS_HAS_POSIX
+        // The target is a file descriptor or a path
+        template<typename TTarget, typename TFormat>
+        std::size_t writeTo(const TTarget& target, TFormat format, const WriteOptions& options = {}) {
+            return Detail::writeStream(iterator, target, format, options);
+        }
+#endif
+    };
+
+
+    template<typename TIt>
+    class StreamIterator {
+        TIt current;
+        TIt end;
+
+    public:
+        STREAMS_CONSTEXPR StreamIterator(TIt b, TIt e)
+            : current{b}, end{e} {}
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return current != end;
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            return end - current;
+        }
+
+        STREAMS_CONSTEXPR auto next() {
+            auto x = Detail::move(*current);
+            current++;
+            return x;
+        }
+
+        template<typename T = TIt, typename = decltype(std::declval<const T&>() - std::declval<const T&>())>
+        auto source() const {
+            return Detail::RangeSource<TIt>{ current, end };
+        }
+
+        template<typename T = TIt>
+        STREAMS_CONSTEXPR auto at(std::size_t idx) const -> decltype(std::declval<const T&>()[0]) {
+            return current[static_cast<std::ptrdiff_t>(idx)];
+        }
+
+        template<typename T = TIt>
+        STREAMS_CONSTEXPR auto size() const -> decltype(static_cast<std::size_t>(std::declval<const T&>() - std::declval<const T&>())) {
+            return static_cast<std::size_t>(end - current);
+        }
+    };
+
+    template<typename TStreamIt, typename TLam>
+    using MapStream = Stream<MapIterator<TStreamIt, TLam>>;
+
+    template<typename TStreamIt, typename TLam>
+    using FlatMapStream = Stream<FlatMapIterator<TStreamIt, TLam>>;
+
+    template<typename TStreamIt, typename TLam>
+    using FilterStream = Stream<FilterIterator<TStreamIt, TLam>>;
+
+    template<typename TStreamIt, typename TLam>
+    using TapStream = Stream<TapIterator<TStreamIt, TLam>>;
+
+    template<typename TStreamIt>
+    using LimitStream = Stream<LimitIterator<TStreamIt>>;
+
+    template<typename TStreamIt>
+    using NoAllocStream = Stream<NoAllocIterator<TStreamIt>>;
+
+    template<typename TStreamIt, typename TParser, typename TSink>
+    using ParseStream = Stream<ParseIterator<TStreamIt, TParser, TSink>>;
+
+    template<typename TStreamIt, typename TParser, typename TSink>
+    using ParseFieldsStream = Stream<ParseFieldsIterator<TStreamIt, TParser, TSink>>;
+
+    template<typename TIt>
+    class VectorStream : public Stream<StreamIterator<TIt>> {
+    public:
+        STREAMS_CONSTEXPR VectorStream(TIt b, TIt e)
+            : Stream<StreamIterator<TIt>>{ StreamIterator<TIt>{Detail::move(b), Detail::move(e)} } {}
+    };
+
+    template<typename TIt, std::size_t size>
+    class ArrayIterator : public StreamIterator<TIt> {
+    public:
+        static constexpr std::size_t extent = size;
+
+        STREAMS_CONSTEXPR ArrayIterator(TIt b)
+            : StreamIterator<TIt>{ b, b + size } {}
+    };
+
+    template<typename TIt, std::size_t size>
+    class ArrayStream : public Stream<ArrayIterator<TIt, size>> {
+    public:
+        STREAMS_CONSTEXPR ArrayStream(TIt b)
+            : Stream<ArrayIterator<TIt, size>>{ ArrayIterator<TIt, size>{ b } } {}
+    };
+
+    template<typename TIt, typename TSentinel>
+    class RangeIterator {
+        TIt current;
+        TSentinel end;
+
+    public:
+        STREAMS_CONSTEXPR RangeIterator(TIt b, TSentinel e)
+            : current{ Detail::move(b) }, end{ Detail::move(e) } {}
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return !(current == end);
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            if constexpr (Detail::isSizedSentinel<TIt, TSentinel>) {
+                return static_cast<int>(end - current);
+            }
+            else {
+                return 0;
+            }
+        }
+
+        STREAMS_CONSTEXPR auto next() {
+            auto x = *current;
+            ++current;
+            return x;
+        }
+    };
+
+    template<typename TIt, typename TSentinel>
+    class RangeStream : public Stream<RangeIterator<TIt, TSentinel>> {
+    public:
+        STREAMS_CONSTEXPR RangeStream(TIt b, TSentinel e)
+            : Stream<RangeIterator<TIt, TSentinel>>{ RangeIterator<TIt, TSentinel>{ Detail::move(b), Detail::move(e) } } {}
+    };
+
+    template<typename TRange>
+    class OwningRangeIterator : public RangeIterator<Detail::RangeIteratorOf<TRange>, Detail::RangeSentinelOf<TRange>> {
+        std::shared_ptr<TRange> range;
+
+    public:
+        OwningRangeIterator(std::shared_ptr<TRange> r)
+            : RangeIterator<Detail::RangeIteratorOf<TRange>, Detail::RangeSentinelOf<TRange>>{ std::begin(*r), std::end(*r) }, range{ Detail::move(r) } {}
+    };
+
+    template<typename TRange>
+    class OwningRangeStream : public Stream<OwningRangeIterator<TRange>> {
+    public:
+        OwningRangeStream(std::shared_ptr<TRange> range)
+            : Stream<OwningRangeIterator<TRange>>{ OwningRangeIterator<TRange>{ Detail::move(range) } } {}
+    };
+
+    template<typename T>
+    class EmptyIterator {
+
+    public:
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return false;
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            return 0;
+        }
+
+        STREAMS_CONSTEXPR T next() {
+            throw Detail::Exception{};
+        }
+    };
+
+    template<typename T>
+    class EmptyStream : public Stream<EmptyIterator<T>> {
+    public:
+        STREAMS_CONSTEXPR EmptyStream()
+            : Stream<EmptyIterator<T>>{ EmptyIterator<T>{} } {}
+    };
+
+    template<typename T>
+    class IotaIterator {
+        T current;
+        T last;
+
+    public:
+        STREAMS_CONSTEXPR IotaIterator(T first, T l)
+            : current{ first }, last{ l } {}
+
+        STREAMS_CONSTEXPR bool hasNext() {
+            return current < last;
+        }
+
+        STREAMS_CONSTEXPR int estimateRemaining() {
+            return static_cast<int>(last - current);
+        }
+
+        STREAMS_CONSTEXPR T next() {
+            return current++;
+        }
+    };
+
+    template<typename T>
+    STREAMS_CONSTEXPR auto iota(T first, T last) {
+        return Stream<IotaIterator<T>>{ IotaIterator<T>{ first, last } };
+    }
+
+    namespace Detail {
+        // Philox4x32-10 counter-based generator: block n of a seed is a pure function of (seed, n)
+        class Philox {
+            static constexpr std::uint32_t multiplier0 = 0xD2511F53;
+            static constexpr std::uint32_t multiplier1 = 0xCD9E8D57;
+            static constexpr std::uint32_t weyl0 = 0x9E3779B9;
+            static constexpr std::uint32_t weyl1 = 0xBB67AE85;
+            static constexpr int rounds = 10;
+
+            std::uint32_t key0;
+            std::uint32_t key1;
+
+        public:
+            static constexpr std::size_t width = 8;
+
+            Philox(std::uint64_t seed)
+                : key0{ static_cast<std::uint32_t>(seed) }, key1{ static_cast<std::uint32_t>(seed >> 32) } {}
+
+            void block(std::uint64_t index, std::uint32_t draw, std::uint32_t* out) const {
+                std::uint32_t x0 = static_cast<std::uint32_t>(index);
+                std::uint32_t x1 = static_cast<std::uint32_t>(index >> 32);
+                std::uint32_t x2 = draw;
+                std::uint32_t x3 = 0;
+                std::uint32_t k0 = key0;
+                std::uint32_t k1 = key1;
+                for (int r = 0; r < rounds; r++) {
+                    auto p0 = std::uint64_t{ multiplier0 } * x0;
+                    auto p1 = std::uint64_t{ multiplier1 } * x2;
+                    x0 = static_cast<std::uint32_t>(p1 >> 32) ^ x1 ^ k0;
+                    x1 = static_cast<std::uint32_t>(p1);
+                    x2 = static_cast<std::uint32_t>(p0 >> 32) ^ x3 ^ k1;
+                    x3 = static_cast<std::uint32_t>(p0);
+                    k0 += weyl0;
+                    k1 += weyl1;
+                }
+                out[0] = x0;
+                out[1] = x1;
+                out[2] = x2;
+                out[3] = x3;
+            }
+
+            void blocks(std::uint64_t first, std::uint32_t* out) const {
+                std::uint32_t x0[width];
+                std::uint32_t x1[width];
+                std::uint32_t x2[width]{};
+                std::uint32_t x3[width]{};
+                for (std::size_t lane = 0; lane < width; lane++) {
+                    x0[lane] = static_cast<std::uint32_t>(first + lane);
+                    x1[lane] = static_cast<std::uint32_t>((first + lane) >> 32);
+                }
+
+                std::uint32_t k0 = key0;
+                std::uint32_t k1 = key1;
+                for (int r = 0; r < rounds; r++) {
+                    for (std::size_t lane = 0; lane < width; lane++) {
+                        auto p0 = std::uint64_t{ multiplier0 } * x0[lane];
+                        auto p1 = std::uint64_t{ multiplier1 } * x2[lane];
+                        x0[lane] = static_cast<std::uint32_t>(p1 >> 32) ^ x1[lane] ^ k0;
+                        x1[lane] = static_cast<std::uint32_t>(p1);
+                        x2[lane] = static_cast<std::uint32_t>(p0 >> 32) ^ x3[lane] ^ k1;
+                        x3[lane] = static_cast<std::uint32_t>(p0);
+                    }
+                    k0 += weyl0;
+                    k1 += weyl1;
+                }
+
+                for (std::size_t lane = 0; lane < width; lane++) {
+                    out[4 * lane] = x0[lane];
+                    out[4 * lane + 1] = x1[lane];
+                    out[4 * lane + 2] = x2[lane];
+                    out[4 * lane + 3] = x3[lane];
+                }
+            }
+        };
+
+        // Eight interleaved xoshiro256++ streams, advanced together so that every step is one vector operation
+        class XoshiroLanes {
+        public:
+            static constexpr std::size_t lanes = 8;
+            static constexpr std::size_t steps = 4;
+            static constexpr std::size_t batch = lanes * steps;
+            static constexpr std::size_t seedWords = lanes * 8;
+
+        private:
+            std::uint64_t s0[lanes];
+            std::uint64_t s1[lanes];
+            std::uint64_t s2[lanes];
+            std::uint64_t s3[lanes];
+
+            static std::uint64_t rotl(std::uint64_t x, int k) {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            static std::uint64_t word(const std::uint32_t* words, std::size_t idx) {
+                return std::uint64_t{ words[2 * idx] } | std::uint64_t{ words[2 * idx + 1] } << 32;
+            }
+
+        public:
+            void seed(const std::uint32_t* words) {
+                for (std::size_t lane = 0; lane < lanes; lane++) {
+                    s0[lane] = word(words, 4 * lane);
+                    s1[lane] = word(words, 4 * lane + 1);
+                    s2[lane] = word(words, 4 * lane + 2);
+                    s3[lane] = word(words, 4 * lane + 3);
+                }
+            }
+
+            void fill(std::uint64_t* out) {
+                for (std::size_t step = 0; step < steps; step++) {
+                    for (std::size_t lane = 0; lane < lanes; lane++) {
+                        out[step * lanes + lane] = rotl(s0[lane] + s3[lane], 23) + s0[lane];
+                        auto t = s1[lane] << 17;
+                        s2[lane] ^= s0[lane];
+                        s3[lane] ^= s1[lane];
+                        s1[lane] ^= s2[lane];
+                        s0[lane] ^= s3[lane];
+                        s2[lane] ^= t;
+                        s3[lane] = rotl(s3[lane], 45);
+                    }
+                }
+            }
+        };
+
+        struct Uniform {};
+
+        template<typename T>
+        T uniformFromBits(std::uint64_t bits) {
+            if constexpr (std::is_floating_point_v<T> && sizeof(T) <= 4) {
+                return static_cast<T>(static_cast<std::int32_t>(bits >> 40)) * T{ 0x1.0p-24 };
+            }
+            else if constexpr (std::is_floating_point_v<T>) {
+                return static_cast<T>(static_cast<double>(static_cast<std::int64_t>(bits >> 11)) * 0x1.0p-53);
+            }
+            else {
+                return static_cast<T>(bits);
+            }
+        }
+
+        class CounterEngine {
+            const Philox* generator;
+            std::uint64_t index;
+            const std::uint32_t* words;
+            std::uint32_t extra[4];
+            std::uint32_t draw{ 0 };
+            int used{ 0 };
+
+        public:
+            using result_type = std::uint64_t;
+
+            CounterEngine(const Philox& g, std::uint64_t idx, const std::uint32_t* first)
+                : generator{ &g }, index{ idx }, words{ first } {}
+
+            static constexpr result_type min() {
+                return 0;
+            }
+
+            static constexpr result_type max() {
+                return std::numeric_limits<result_type>::max();
+            }
+
+            result_type operator()() {
+                if (used == 2) {
+                    generator->block(index, ++draw, extra);
+                    words = extra;
+                    used = 0;
+                }
+                auto bits = std::uint64_t{ words[2 * used] } | std::uint64_t{ words[2 * used + 1] } << 32;
+                used++;
+                return bits;
+            }
+        };
+    }
+
+    template<typename T, typename TDist>
+    class RandomIterator {
+        static constexpr std::uint64_t batch = Detail::Philox::width;
+
+        Detail::Philox generator;
+        TDist distribution;
+        std::uint64_t current;
+        std::uint64_t last;
+        std::uint64_t bufferBegin{ 0 };
+        std::uint64_t bufferEnd{ 0 };
+        std::uint32_t buffer[batch * 4];
+
+    public:
+        RandomIterator(Detail::Philox g, TDist dist, std::uint64_t first, std::uint64_t l)
+            : generator{ g }, distribution{ Detail::move(dist) }, current{ first }, last{ l } {}
+
+        bool hasNext() {
+            return current < last;
+        }
+
+        int estimateRemaining() {
+            auto remaining = last - current;
+            return remaining < static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ? static_cast<int>(remaining) : std::numeric_limits<int>::max();
+        }
+
+        T next() {
+            if (current >= bufferEnd) {
+                generator.blocks(current, buffer);
+                bufferBegin = current;
+                bufferEnd = current + batch;
+            }
+
+            Detail::CounterEngine engine{ generator, current, buffer + 4 * (current - bufferBegin) };
+            current++;
+            auto dist = distribution;
+            return static_cast<T>(dist(engine));
+        }
+
+        auto source() const {
+            return Detail::RandomSource<T, TDist>{ generator, distribution, current, last };
+        }
+    };
+
+    template<typename T>
+    class RandomIterator<T, Detail::Uniform> {
+        static constexpr std::uint64_t chunkSize = 1024;
+        static constexpr std::uint64_t batch = Detail::XoshiroLanes::batch;
+
+        Detail::Philox generator;
+        Detail::XoshiroLanes lanes;
+        std::uint64_t current;
+        std::uint64_t last;
+        std::uint64_t position{ batch };
+        std::uint64_t buffer[batch];
+
+        void reseed(std::uint64_t chunk) {
+            constexpr std::size_t wordsPerCall = 4 * Detail::Philox::width;
+            constexpr std::size_t calls = Detail::XoshiroLanes::seedWords / wordsPerCall;
+            std::uint32_t words[Detail::XoshiroLanes::seedWords];
+            for (std::size_t k = 0; k < calls; k++) {
+                generator.blocks((chunk * calls + k) * Detail::Philox::width, words + k * wordsPerCall);
+            }
+            lanes.seed(words);
+        }
+
+    public:
+        RandomIterator(Detail::Philox g, Detail::Uniform, std::uint64_t first, std::uint64_t l)
+            : generator{ g }, current{ first }, last{ l } {
+            auto offset = current % chunkSize;
+            if (offset) {
+                reseed(current / chunkSize);
+                for (auto skip = offset / batch; skip > 0; skip--) {
+                    lanes.fill(buffer);
+                }
+                lanes.fill(buffer);
+                position = offset % batch;
+            }
+        }
+
+        bool hasNext() {
+            return current < last;
+        }
+
+        int estimateRemaining() {
+            auto remaining = last - current;
+            return remaining < static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ? static_cast<int>(remaining) : std::numeric_limits<int>::max();
+        }
+
+        T next() {
+            if (position == batch) {
+                if (current % chunkSize == 0) {
+                    reseed(current / chunkSize);
+                }
+                lanes.fill(buffer);
+                position = 0;
+            }
+
+            current++;
+            return Detail::uniformFromBits<T>(buffer[position++]);
+        }
+
+        auto source() const {
+            return Detail::RandomSource<T, Detail::Uniform>{ generator, {}, current, last };
+        }
+    };
+
+    template<typename T>
+    auto random(std::uint64_t seed) {
+        static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "random<T>(seed) requires an arithmetic value type");
+        using TIt = RandomIterator<T, Detail::Uniform>;
+        return Stream<TIt>{ TIt{ Detail::Philox{ seed }, {}, 0, std::numeric_limits<std::uint64_t>::max() } };
+    }
+
+    template<typename T, typename TDist>
+    auto random(std::uint64_t seed, TDist distribution) {
+        using TIt = RandomIterator<T, TDist>;
+        return Stream<TIt>{ TIt{ Detail::Philox{ seed }, Detail::move(distribution), 0, std::numeric_limits<std::uint64_t>::max() } };
+    }
+
+    class JsonRecord {
+        std::string_view text;
+
+        std::string_view extractValue(Detail::StructuralScanner& scanner, const char* pos) const {
+            auto end = scanner.getEnd();
+            while (pos != end && Detail::isJsonWhitespace(*pos)) {
+                pos++;
+            }
+
+            if (pos == end) {
+                return {};
+            }
+
+            const char* valueEnd;
+            if (*pos == '"') {
+                scanner.seek(pos + 1);
+                valueEnd = scanner.skipString();
+                valueEnd = valueEnd == end ? end : valueEnd + 1;
+            }
+            else if (*pos == '{' || *pos == '[') {
+                scanner.seek(pos + 1);
+                valueEnd = scanner.skipNested();
+                valueEnd = valueEnd == end ? end : valueEnd + 1;
+            }
+            else {
+                scanner.seek(pos);
+                valueEnd = scanner.next();
+                while (valueEnd != pos && Detail::isJsonWhitespace(valueEnd[-1])) {
+                    valueEnd--;
+                }
+            }
+
+            return { pos, static_cast<std::size_t>(valueEnd - pos) };
+        }
+
+        static bool convert(std::string_view raw, std::string_view& value) {
+            if (raw.size() >= 2 && raw.front() == '"') {
+                value = raw.substr(1, raw.size() - 2);
+            }
+            else {
+                value = raw;
+            }
+            return true;
+        }
+
+        static bool convert(std::string_view raw, JsonRecord& value) {
+            value = JsonRecord{ raw };
+            return raw.size() >= 2 && raw.front() == '{';
+        }
+
+        static bool convert(std::string_view raw, bool& value) {
+            if (raw == "true" || raw == "false") {
+                value = raw == "true";
+                return true;
+            }
+            return false;
+        }
+
+        template<typename T>
+        static bool convert(std::string_view raw, T& value) {
+            static_assert(std::is_arithmetic<T>::value, "Unsupported JSON field type");
+            return Detail::FromCharsParser<T>{}(raw, value) == std::errc{};
+        }
+
+    public:
+        JsonRecord() = default;
+
+        JsonRecord(std::string_view t)
+            : text{ t } {}
+
+        std::string_view raw() const {
+            return text;
+        }
+
+        std::string_view find(std::string_view key) const {
+            Detail::StructuralScanner scanner{ text.data(), text.data() + text.size() };
+            auto end = scanner.getEnd();
+            int depth = 0;
+            bool expectKey = false;
+
+            for (auto pos = scanner.next(); pos != end; pos = scanner.next()) {
+                switch (*pos) {
+                case '"': {
+                    auto keyEnd = scanner.skipString();
+                    if (keyEnd == end) {
+                        return {};
+                    }
+
+                    if (depth == 1 && expectKey) {
+                        expectKey = false;
+                        auto colon = scanner.next();
+                        if (colon == end || *colon != ':') {
+                            return {};
+                        }
+
+                        if (std::string_view{ pos + 1, static_cast<std::size_t>(keyEnd - pos - 1) } == key) {
+                            return extractValue(scanner, colon + 1);
+                        }
+                    }
+                    break;
+                }
+                case '{':
+                case '[':
+                    depth++;
+                    expectKey = *pos == '{' && depth == 1;
+                    break;
+                case '}':
+                case ']':
+                    if (--depth <= 0) {
+                        return {};
+                    }
+                    break;
+                case ',':
+                    expectKey = depth == 1;
+                    break;
+                }
+            }
+
+            return {};
+        }
+
+        bool has(std::string_view key) const {
+            return !find(key).empty();
+        }
+
+        template<typename T>
+        bool tryGet(std::string_view key, T& value) const {
+            auto raw = find(key);
+            if (raw.empty() || raw == "null") {
+                return false;
+            }
+            return convert(raw, value);
+        }
+
+        template<typename T>
+        T get(std::string_view key, T fallback = T{}) const {
+            T value{};
+            return tryGet(key, value) ? value : fallback;
+        }
+    };
+
+    class JsonLinesIterator {
+        std::shared_ptr<Detail::MappedFile> file;
+        const char* current;
+        const char* end;
+
+        void skipBlank() {
+            while (current != end && Detail::isJsonWhitespace(*current)) {
+                current++;
+            }
+        }
+
+    public:
+        JsonLinesIterator(std::shared_ptr<Detail::MappedFile> f, const char* b, const char* e)
+            : file{ Detail::move(f) }, current{ b }, end{ e } {
+            skipBlank();
+        }
+
+        bool hasNext() {
+            return current != end;
+        }
+
+        int estimateRemaining() {
+            return static_cast<int>((end - current) / 64);
+        }
+
+        JsonRecord next() {
+            auto lineEnd = static_cast<const char*>(std::memchr(current, '\n', static_cast<std::size_t>(end - current)));
+            lineEnd = lineEnd ? lineEnd : end;
+
+            JsonRecord record{ { current, static_cast<std::size_t>(lineEnd - current) } };
+            current = lineEnd;
+            skipBlank();
+            return record;
+        }
+    };
+
+    class JsonLinesStream : public Stream<JsonLinesIterator> {
+    public:
+        JsonLinesStream(std::shared_ptr<Detail::MappedFile> f, const char* b, const char* e)
+            : Stream<JsonLinesIterator>{ JsonLinesIterator{ Detail::move(f), b, e } } {}
+    };
+
+    inline auto jsonLinesBuffer(std::string_view buffer) {
+        return JsonLinesStream{ nullptr, buffer.data(), buffer.data() + buffer.size() };
+    }
+
+}
+
+#if defined(STREAMS_EXTERN_TEMPLATES) || defined(STREAMS_DEFINE_EXTERN_TEMPLATES)
+#ifdef STREAMS_DEFINE_EXTERN_TEMPLATES
+#define STREAMS_TEMPLATE_INSTANCE(...) template class __VA_ARGS__;
+#else
+#define STREAMS_TEMPLATE_INSTANCE(...) extern template class __VA_ARGS__;
+#endif
+
+#define STREAMS_SOURCE_TEMPLATES(T) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::StreamIterator<T*>) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::StreamIterator<const T*>) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::StreamIterator<std::vector<T>::iterator>) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::Stream<Stream::StreamIterator<T*>>) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::Stream<Stream::StreamIterator<const T*>>) \
+    STREAMS_TEMPLATE_INSTANCE(Stream::Stream<Stream::StreamIterator<std::vector<T>::iterator>>)
+
+STREAMS_SOURCE_TEMPLATES(int)
+STREAMS_SOURCE_TEMPLATES(long)
+STREAMS_SOURCE_TEMPLATES(double)
+STREAMS_SOURCE_TEMPLATES(std::string)
+
+#undef STREAMS_SOURCE_TEMPLATES
+#undef STREAMS_TEMPLATE_INSTANCE
+#endif
+
+#ifdef STREAMS_DEFINE_ALLOCATION_HOOKS
+namespace Stream {
+    namespace Detail {
+        inline void* countedAllocate(std::size_t size, std::size_t alignment) {
+            auto& counters = allocationCounters();
+            counters.allocations++;
+            counters.bytes += size;
+
+            size = size ? size : 1;
+            while (true) {
+                void* ptr;
+                if (alignment <= alignof(std::max_align_t)) {
+                    ptr = std::malloc(size);
+                }
+                else {
+#ifdef _MSC_VER
+                    ptr = ::_aligned_malloc(size, alignment);
+#else
+                    ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+                }
+                if (ptr) {
+                    return ptr;
+                }
+
+                auto handler = std::get_new_handler();
+                if (!handler) {
+                    return nullptr;
+                }
+                handler();
+            }
+        }
+
+        inline void* countedAllocateOrThrow(std::size_t size, std::size_t alignment) {
+            if (void* ptr = countedAllocate(size, alignment)) {
+                return ptr;
+            }
+            throw std::bad_alloc{};
+        }
+
+        inline void countedFree(void* ptr, std::size_t alignment) {
+#ifdef _MSC_VER
+            if (alignment > alignof(std::max_align_t)) {
+                ::_aligned_free(ptr);
+                return;
+            }
+#endif
+            (void)alignment;
+            std::free(ptr);
+        }
+    }
+}
+
+void* operator new(std::size_t size) {
+    return Stream::Detail::countedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+    return Stream::Detail::countedAllocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Stream::Detail::countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Stream::Detail::countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return Stream::Detail::countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return Stream::Detail::countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return Stream::Detail::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return Stream::Detail::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete[](void* ptr) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    Stream::Detail::countedFree(ptr, alignof(std::max_align_t));
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    Stream::Detail::countedFree(ptr, static_cast<std::size_t>(alignment));
+}
+#endif
+
+#ifdef STREAMS_ENABLE_PROFILING
+#include "streams_profile.h"
+#endif
\ No newline at end of file
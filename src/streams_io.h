@@ -0,0 +1,1344 @@
+﻿#pragma once
+
+#include "streams_parallel.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef STREAMS_HAS_POSIX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef STREAMS_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Stream {
+
+    namespace Detail {
+
+        class MappedFile {
+            const char* bytes{ nullptr };
+            std::size_t length{ 0 };
+            bool isMapped{ false };
+            std::unique_ptr<char[]> buffer;
+
+            void readAll(const std::filesystem::path& path) {
+                std::FILE* file = std::fopen(path.string().c_str(), "rb");
+                if (!file) {
+                    throw IOException{ errno };
+                }
+
+                std::size_t capacity = 1 << 16;
+                buffer.reset(new char[capacity]);
+                std::size_t num;
+                while ((num = std::fread(buffer.get() + length, 1, capacity - length, file)) > 0) {
+                    length += num;
+                    if (length == capacity) {
+                        std::unique_ptr<char[]> grown{ new char[capacity * 2] };
+                        std::memcpy(grown.get(), buffer.get(), length);
+                        buffer = Detail::move(grown);
+                        capacity *= 2;
+                    }
+                }
+
+                bool failed = std::ferror(file) != 0;
+                std::fclose(file);
+                if (failed) {
+                    throw IOException{ EIO };
+                }
+
+                bytes = buffer.get();
+            }
+
+        public:
+            MappedFile(const std::filesystem::path& path) {
+#ifdef STREAMS_HAS_POSIX
+                int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) {
+                    throw IOException{ errno };
+                }
+
+                struct stat info;
+                if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+                    void* addr = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (addr != MAP_FAILED) {
+                        ::madvise(addr, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+                        bytes = static_cast<const char*>(addr);
+                        length = static_cast<std::size_t>(info.st_size);
+                        isMapped = true;
+                        ::close(fd);
+                        return;
+                    }
+                }
+                ::close(fd);
+#endif
+                readAll(path);
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile() {
+#ifdef STREAMS_HAS_POSIX
+                if (isMapped) {
+                    ::munmap(const_cast<char*>(bytes), length);
+                }
+#endif
+            }
+
+            const char* data() const {
+                return bytes;
+            }
+
+            std::size_t size() const {
+                return length;
+            }
+        };
+
+#ifdef STREAMS_HAS_IO_URING
+        // Minimal io_uring submission/completion ring driven by raw syscalls
+        class IoUring {
+            int ringFd{ -1 };
+            unsigned entries{ 0 };
+            unsigned pendingSubmits{ 0 };
+
+            void* sqRing{ MAP_FAILED };
+            void* cqRing{ MAP_FAILED };
+            std::size_t sqRingSize{ 0 };
+            std::size_t cqRingSize{ 0 };
+            io_uring_sqe* sqes{ static_cast<io_uring_sqe*>(MAP_FAILED) };
+            std::size_t sqesSize{ 0 };
+
+            unsigned* sqHead{ nullptr };
+            unsigned* sqTail{ nullptr };
+            unsigned* sqMask{ nullptr };
+            unsigned* sqArray{ nullptr };
+            unsigned* cqHead{ nullptr };
+            unsigned* cqTail{ nullptr };
+            unsigned* cqMask{ nullptr };
+            io_uring_cqe* cqes{ nullptr };
+
+            void release() {
+                if (sqes != MAP_FAILED) {
+                    ::munmap(sqes, sqesSize);
+                }
+                if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                    ::munmap(cqRing, cqRingSize);
+                }
+                if (sqRing != MAP_FAILED) {
+                    ::munmap(sqRing, sqRingSize);
+                }
+                if (ringFd >= 0) {
+                    ::close(ringFd);
+                }
+                ringFd = -1;
+            }
+
+        public:
+            IoUring(unsigned depth) {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+                if (ringFd < 0) {
+                    ringFd = -1;
+                    return;
+                }
+
+                entries = params.sq_entries;
+                sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+                if (singleMap) {
+                    sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+                }
+
+                sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+                cqRing = singleMap ? sqRing : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+                sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+                if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+                    release();
+                    return;
+                }
+
+                auto sqBase = static_cast<char*>(sqRing);
+                sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+                sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+                sqMask = reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+                sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+
+                auto cqBase = static_cast<char*>(cqRing);
+                cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+                cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+                cqMask = reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+                cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+            }
+
+            IoUring(const IoUring&) = delete;
+            IoUring& operator=(const IoUring&) = delete;
+
+            ~IoUring() {
+                release();
+            }
+
+            bool isValid() const {
+                return ringFd >= 0;
+            }
+
+            bool registerBuffers(const iovec* vecs, unsigned count) {
+                return ::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, vecs, count) == 0;
+            }
+
+            io_uring_sqe* prepare(std::uint8_t opcode, int fd, void* data, unsigned size, std::uint64_t offset, std::uint64_t userData) {
+                unsigned tail = *sqTail;
+                if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries) {
+                    return nullptr;
+                }
+
+                auto idx = tail & *sqMask;
+                auto sqe = &sqes[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = opcode;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<std::uint64_t>(data);
+                sqe->len = size;
+                sqe->off = offset;
+                sqe->user_data = userData;
+
+                sqArray[idx] = idx;
+                __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+                pendingSubmits++;
+                return sqe;
+            }
+
+            int submit(unsigned waitFor) {
+                while (true) {
+                    auto num = ::syscall(__NR_io_uring_enter, ringFd, pendingSubmits, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+                    if (num >= 0) {
+                        pendingSubmits -= static_cast<unsigned>(num);
+                        return 0;
+                    }
+                    if (errno != EINTR) {
+                        return errno;
+                    }
+                }
+            }
+
+            bool popCompletion(io_uring_cqe& completion) {
+                unsigned head = *cqHead;
+                if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                    return false;
+                }
+
+                completion = cqes[head & *cqMask];
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        };
+#endif
+    }
+
+#ifdef STREAMS_HAS_POSIX
+    enum class FsyncPolicy {
+        Never,
+        OnClose,
+        EveryFlush
+    };
+
+    enum class PartialWritePolicy {
+        Retry,
+        Fail
+    };
+
+    struct WriteOptions {
+        std::size_t bufferSize{ 1 << 20 };
+        int bufferCount{ 2 };
+        bool background{ false };
+        bool asyncIo{ false };
+        FsyncPolicy fsync{ FsyncPolicy::Never };
+        PartialWritePolicy partialWrites{ PartialWritePolicy::Retry };
+    };
+
+    struct ReadOptions {
+        std::size_t blockSize{ 1 << 20 };
+        int queueDepth{ 8 };
+        bool asyncIo{ false };
+    };
+
+    namespace Detail {
+
+        inline int readFully(int fd, char* data, std::size_t size, std::uint64_t offset, std::size_t& numRead) {
+            numRead = 0;
+            while (numRead < size) {
+                auto num = ::pread(fd, data + numRead, size - numRead, static_cast<off_t>(offset + numRead));
+                if (num < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                if (num == 0) {
+                    break;
+                }
+                numRead += static_cast<std::size_t>(num);
+            }
+            return 0;
+        }
+
+        inline int readStream(int fd, char* data, std::size_t size, std::size_t& numRead) {
+            numRead = 0;
+            while (numRead < size) {
+                auto num = ::read(fd, data + numRead, size - numRead);
+                if (num < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                if (num == 0) {
+                    break;
+                }
+                numRead += static_cast<std::size_t>(num);
+            }
+            return 0;
+        }
+
+        class FileReader {
+            static constexpr std::size_t alignment = 4096;
+
+            int fd{ -1 };
+            bool ownsFd;
+            bool seekable{ false };
+            int lookahead{ -1 };
+            ReadOptions options;
+            std::uint64_t readOffset;
+            std::uint64_t endOffset;
+            std::vector<char*> buffers;
+
+#ifdef STREAMS_HAS_IO_URING
+            struct Slot {
+                std::uint64_t offset;
+                std::size_t size;
+                int result;
+                bool inFlight;
+                bool done;
+            };
+
+            std::unique_ptr<IoUring> ring;
+            std::vector<Slot> slots;
+            bool fixedBuffers{ false };
+            std::uint64_t submitOffset{ 0 };
+            std::size_t submitIdx{ 0 };
+            std::size_t deliverIdx{ 0 };
+            int inFlight{ 0 };
+
+            void submitNext() {
+                if (submitOffset >= endOffset) {
+                    return;
+                }
+
+                auto idx = submitIdx % slots.size();
+                auto& slot = slots[idx];
+                slot.offset = submitOffset;
+                slot.size = endOffset - submitOffset < options.blockSize ? static_cast<std::size_t>(endOffset - submitOffset) : options.blockSize;
+                slot.done = false;
+                slot.inFlight = true;
+
+                auto sqe = ring->prepare(fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buffers[idx], static_cast<unsigned>(slot.size), slot.offset, idx);
+                if (fixedBuffers) {
+                    sqe->buf_index = static_cast<std::uint16_t>(idx);
+                }
+
+                submitOffset += slot.size;
+                submitIdx++;
+                inFlight++;
+            }
+
+            void reap(bool wait) {
+                io_uring_cqe completion;
+                bool any = false;
+                while (true) {
+                    while (ring->popCompletion(completion)) {
+                        auto& slot = slots[completion.user_data];
+                        slot.result = completion.res;
+                        slot.inFlight = false;
+                        slot.done = true;
+                        inFlight--;
+                        any = true;
+                    }
+
+                    if (any || !wait) {
+                        return;
+                    }
+                    if (int error = ring->submit(1)) {
+                        throw IOException{ error };
+                    }
+                }
+            }
+
+            void setupRing() {
+                if (!options.asyncIo || options.queueDepth < 2) {
+                    return;
+                }
+
+                auto candidate = std::make_unique<IoUring>(static_cast<unsigned>(options.queueDepth));
+                if (!candidate->isValid()) {
+                    return;
+                }
+
+                ring = Detail::move(candidate);
+                for (int i = 1; i < options.queueDepth; i++) {
+                    buffers.push_back(static_cast<char*>(::operator new(options.blockSize, std::align_val_t{ alignment })));
+                }
+
+                std::vector<iovec> vecs;
+                for (auto buffer : buffers) {
+                    vecs.push_back({ buffer, options.blockSize });
+                }
+                fixedBuffers = ring->registerBuffers(vecs.data(), static_cast<unsigned>(vecs.size()));
+
+                slots.resize(buffers.size());
+                submitOffset = readOffset;
+                for (std::size_t i = 0; i < slots.size(); i++) {
+                    submitNext();
+                }
+                if (int error = ring->submit(0)) {
+                    throw IOException{ error };
+                }
+            }
+
+            std::string_view nextAsync() {
+                if (deliverIdx) {
+                    submitNext();
+                    if (int error = ring->submit(0)) {
+                        throw IOException{ error };
+                    }
+                }
+
+                auto idx = deliverIdx % slots.size();
+                auto& slot = slots[idx];
+                while (!slot.done) {
+                    reap(true);
+                }
+                deliverIdx++;
+
+                std::size_t numRead = slot.result > 0 ? static_cast<std::size_t>(slot.result) : 0;
+                if (slot.result < 0 && slot.result != -EINVAL && slot.result != -EOPNOTSUPP) {
+                    throw IOException{ -slot.result };
+                }
+
+                if (numRead < slot.size) {
+                    std::size_t remaining;
+                    if (int error = readFully(fd, buffers[idx] + numRead, slot.size - numRead, slot.offset + numRead, remaining)) {
+                        throw IOException{ error };
+                    }
+                    numRead += remaining;
+                }
+
+                readOffset = slot.offset + slot.size;
+                if (numRead < slot.size) {
+                    endOffset = readOffset;
+                }
+                return { buffers[idx], numRead };
+            }
+#endif
+
+            // A pipe only reports its end by a read returning nothing, so one byte is read ahead to keep hasNext() exact.
+            void readLookahead() {
+                char byte;
+                std::size_t numRead;
+                if (int error = readStream(fd, &byte, 1, numRead)) {
+                    throw IOException{ error };
+                }
+
+                lookahead = numRead ? static_cast<unsigned char>(byte) : -1;
+                if (!numRead) {
+                    endOffset = readOffset;
+                }
+            }
+
+            std::string_view nextStream(std::size_t size) {
+                std::size_t numRead = 0;
+                if (lookahead >= 0) {
+                    buffers[0][0] = static_cast<char>(lookahead);
+                    numRead = 1;
+                }
+
+                std::size_t num;
+                if (int error = readStream(fd, buffers[0] + numRead, size - numRead, num)) {
+                    throw IOException{ error };
+                }
+                numRead += num;
+                readOffset += numRead;
+                if (numRead < size) {
+                    lookahead = -1;
+                    endOffset = readOffset;
+                }
+                else {
+                    readLookahead();
+                }
+                return { buffers[0], numRead };
+            }
+
+            void init() {
+                struct stat info;
+                seekable = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+                if (seekable && static_cast<std::uint64_t>(info.st_size) < endOffset) {
+                    endOffset = static_cast<std::uint64_t>(info.st_size);
+                }
+
+                options.blockSize = (options.blockSize + alignment - 1) / alignment * alignment;
+                buffers.push_back(static_cast<char*>(::operator new(options.blockSize, std::align_val_t{ alignment })));
+                if (!seekable) {
+                    readLookahead();
+                    return;
+                }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+                ::posix_fadvise(fd, static_cast<off_t>(readOffset), static_cast<off_t>(endOffset - readOffset), POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef STREAMS_HAS_IO_URING
+                setupRing();
+#endif
+            }
+
+        public:
+            FileReader(const std::filesystem::path& path, ReadOptions o, std::uint64_t begin = 0, std::uint64_t end = ~std::uint64_t{ 0 })
+                : ownsFd{ true }, options{ o }, readOffset{ begin }, endOffset{ end } {
+                fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) {
+                    throw IOException{ errno };
+                }
+                init();
+            }
+
+            FileReader(int f, ReadOptions o, std::uint64_t begin, std::uint64_t end)
+                : fd{ f }, ownsFd{ false }, options{ o }, readOffset{ begin }, endOffset{ end } {
+                init();
+            }
+
+            FileReader(const FileReader&) = delete;
+            FileReader& operator=(const FileReader&) = delete;
+
+            ~FileReader() {
+                bool buffersInUse = false;
+#ifdef STREAMS_HAS_IO_URING
+                if (ring) {
+                    try {
+                        while (inFlight > 0) {
+                            reap(true);
+                        }
+                    }
+                    catch (const IOException&) {}
+                    // Reads that could not be reaped may still land in their buffers, so those are leaked rather than freed.
+                    buffersInUse = inFlight > 0;
+                    ring.reset();
+                }
+#endif
+                if (!buffersInUse) {
+                    for (auto buffer : buffers) {
+                        ::operator delete(buffer, std::align_val_t{ alignment });
+                    }
+                }
+                if (ownsFd) {
+                    ::close(fd);
+                }
+            }
+
+            void prefetch() {
+#ifdef POSIX_FADV_WILLNEED
+                if (!seekable) {
+                    return;
+                }
+                ::posix_fadvise(fd, static_cast<off_t>(readOffset), static_cast<off_t>(endOffset - readOffset), POSIX_FADV_WILLNEED);
+#endif
+            }
+
+            bool isAsync() const {
+#ifdef STREAMS_HAS_IO_URING
+                return ring != nullptr;
+#else
+                return false;
+#endif
+            }
+
+            bool hasNext() const {
+                return readOffset < endOffset;
+            }
+
+            std::uint64_t remaining() const {
+                return endOffset - readOffset;
+            }
+
+            std::string_view next() {
+#ifdef STREAMS_HAS_IO_URING
+                if (ring) {
+                    return nextAsync();
+                }
+#endif
+                auto size = endOffset - readOffset < options.blockSize ? static_cast<std::size_t>(endOffset - readOffset) : options.blockSize;
+                if (!seekable) {
+                    return nextStream(size);
+                }
+
+                std::size_t numRead;
+                if (int error = readFully(fd, buffers[0], size, readOffset, numRead)) {
+                    throw IOException{ error };
+                }
+
+                readOffset += size;
+                if (numRead < size) {
+                    endOffset = readOffset;
+                }
+                return { buffers[0], numRead };
+            }
+        };
+    }
+
+    class BufferedWriter {
+        static constexpr std::size_t alignment = 4096;
+        static constexpr int maxBatch = 16;
+
+        struct Chunk {
+            char* data;
+            std::size_t size;
+        };
+
+        int fd;
+        bool ownsFd;
+        WriteOptions options;
+
+        std::vector<char*> buffers;
+        char* current{ nullptr };
+        std::size_t used{ 0 };
+        std::size_t bytesWritten{ 0 };
+        bool isClosed{ false };
+
+        std::thread writerThread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<Chunk> pending;
+        std::vector<char*> freeBuffers;
+        bool stopping{ false };
+        int error{ 0 };
+
+#ifdef STREAMS_HAS_IO_URING
+        struct WriteSlot {
+            std::uint64_t offset;
+            std::size_t size;
+            bool inFlight;
+        };
+
+        std::unique_ptr<Detail::IoUring> ring;
+        std::vector<WriteSlot> writeSlots;
+        std::uint64_t fileOffset{ 0 };
+        bool fixedBuffers{ false };
+        int inFlight{ 0 };
+
+        bool setupRing() {
+            struct stat info;
+            auto offset = ::lseek(fd, 0, SEEK_CUR);
+            if (offset < 0 || ::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                return false;
+            }
+
+            auto candidate = std::make_unique<Detail::IoUring>(static_cast<unsigned>(options.bufferCount));
+            if (!candidate->isValid()) {
+                return false;
+            }
+
+            ring = Detail::move(candidate);
+            fileOffset = static_cast<std::uint64_t>(offset);
+            writeSlots.assign(buffers.size(), WriteSlot{ 0, 0, false });
+
+            std::vector<iovec> vecs;
+            for (auto buffer : buffers) {
+                vecs.push_back({ buffer, options.bufferSize });
+            }
+            fixedBuffers = ring->registerBuffers(vecs.data(), static_cast<unsigned>(vecs.size()));
+            return true;
+        }
+
+        int writeAt(const char* data, std::size_t size, std::uint64_t offset) {
+            while (size) {
+                auto num = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+                if (num < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+
+                auto written = static_cast<std::size_t>(num);
+                bytesWritten += written;
+                if (written < size && options.partialWrites == PartialWritePolicy::Fail) {
+                    return EIO;
+                }
+                data += written;
+                size -= written;
+                offset += written;
+            }
+            return 0;
+        }
+
+        int reapWrites() {
+            io_uring_cqe completion;
+            while (!ring->popCompletion(completion)) {
+                Detail::TraceScope wait{ "queue full" };
+                if (int result = ring->submit(1)) {
+                    return result;
+                }
+            }
+
+            int result = 0;
+            do {
+                auto idx = static_cast<std::size_t>(completion.user_data);
+                auto& slot = writeSlots[idx];
+                slot.inFlight = false;
+                inFlight--;
+
+                if (completion.res == -EINVAL || completion.res == -EOPNOTSUPP) {
+                    result = result ? result : writeAt(buffers[idx], slot.size, slot.offset);
+                    continue;
+                }
+                if (completion.res < 0) {
+                    result = result ? result : -completion.res;
+                    continue;
+                }
+
+                auto written = static_cast<std::size_t>(completion.res);
+                bytesWritten += written;
+                if (written < slot.size) {
+                    if (options.partialWrites == PartialWritePolicy::Fail) {
+                        result = result ? result : EIO;
+                        continue;
+                    }
+                    result = result ? result : writeAt(buffers[idx] + written, slot.size - written, slot.offset + written);
+                }
+            } while (ring->popCompletion(completion));
+
+            if (!result && options.fsync == FsyncPolicy::EveryFlush) {
+                result = syncFile();
+            }
+            return result;
+        }
+
+        void handOverAsync() {
+            std::size_t idx = 0;
+            while (buffers[idx] != current) {
+                idx++;
+            }
+
+            writeSlots[idx] = { fileOffset, used, true };
+            auto sqe = ring->prepare(fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, current, static_cast<unsigned>(used), fileOffset, idx);
+            if (fixedBuffers) {
+                sqe->buf_index = static_cast<std::uint16_t>(idx);
+            }
+            fileOffset += used;
+            used = 0;
+            inFlight++;
+
+            if (int result = ring->submit(0)) {
+                throw Detail::IOException{ result };
+            }
+
+            while (true) {
+                for (std::size_t i = 0; i < writeSlots.size(); i++) {
+                    if (!writeSlots[i].inFlight) {
+                        current = buffers[i];
+                        return;
+                    }
+                }
+
+                if (int result = reapWrites()) {
+                    throw Detail::IOException{ result };
+                }
+            }
+        }
+
+        int drainRing() {
+            int result = 0;
+            while (inFlight > 0) {
+                auto pending = inFlight;
+                int reaped = reapWrites();
+                result = result ? result : reaped;
+                if (reaped && inFlight == pending) {
+                    break;
+                }
+            }
+
+            if (!ownsFd) {
+                ::lseek(fd, static_cast<off_t>(fileOffset), SEEK_SET);
+            }
+            return result;
+        }
+#endif
+
+        void allocateBuffers() {
+            options.bufferSize = (options.bufferSize + alignment - 1) / alignment * alignment;
+            options.bufferCount = options.background || options.asyncIo ? (options.bufferCount < 2 ? 2 : options.bufferCount) : 1;
+            try {
+                buffers.reserve(static_cast<std::size_t>(options.bufferCount));
+                for (int i = 0; i < options.bufferCount; i++) {
+                    buffers.push_back(static_cast<char*>(::operator new(options.bufferSize, std::align_val_t{ alignment })));
+                }
+
+                current = buffers[0];
+                freeBuffers.assign(buffers.begin() + 1, buffers.end());
+#ifdef STREAMS_HAS_IO_URING
+                if (options.asyncIo && setupRing()) {
+                    return;
+                }
+#endif
+                options.asyncIo = false;
+                if (options.background) {
+                    writerThread = std::thread{ [this]() { runWriter(); } };
+                }
+            }
+            catch (...) {
+                // The destructor does not run when a constructor throws, so the buffers are released here.
+                for (auto buffer : buffers) {
+                    ::operator delete(buffer, std::align_val_t{ alignment });
+                }
+                throw;
+            }
+        }
+
+        int writeChunks(Chunk* chunks, int count) {
+            iovec vecs[maxBatch];
+            int numVecs = 0;
+            for (int i = 0; i < count; i++) {
+                if (chunks[i].size) {
+                    vecs[numVecs++] = { chunks[i].data, chunks[i].size };
+                }
+            }
+
+            iovec* vec = vecs;
+            while (numVecs > 0) {
+                auto num = ::writev(fd, vec, numVecs);
+                if (num < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        pollfd waiter{ fd, POLLOUT, 0 };
+                        ::poll(&waiter, 1, -1);
+                        continue;
+                    }
+                    return errno;
+                }
+
+                auto written = static_cast<std::size_t>(num);
+                bytesWritten += written;
+                while (numVecs > 0 && written >= vec->iov_len) {
+                    written -= vec->iov_len;
+                    vec++;
+                    numVecs--;
+                }
+
+                if (numVecs > 0) {
+                    if (options.partialWrites == PartialWritePolicy::Fail) {
+                        return EIO;
+                    }
+                    vec->iov_base = static_cast<char*>(vec->iov_base) + written;
+                    vec->iov_len -= written;
+                }
+            }
+
+            if (options.fsync == FsyncPolicy::EveryFlush) {
+                return syncFile();
+            }
+            return 0;
+        }
+
+        int syncFile() {
+#ifdef __linux__
+            return ::fdatasync(fd) == 0 ? 0 : errno;
+#else
+            return ::fsync(fd) == 0 ? 0 : errno;
+#endif
+        }
+
+        void runWriter() {
+            std::vector<Chunk> batch;
+            std::unique_lock<std::mutex> lock{ mutex };
+            while (true) {
+                if (pending.empty() && !stopping) {
+                    Detail::TraceScope wait{ "queue empty" };
+                    condition.wait(lock, [this]() { return !pending.empty() || stopping; });
+                }
+                if (pending.empty()) {
+                    return;
+                }
+
+                batch.swap(pending);
+                lock.unlock();
+
+                int result = error;
+                for (std::size_t i = 0; i < batch.size() && !result; i += maxBatch) {
+                    int count = batch.size() - i < maxBatch ? static_cast<int>(batch.size() - i) : maxBatch;
+                    result = writeChunks(batch.data() + i, count);
+                }
+
+                lock.lock();
+                error = error ? error : result;
+                for (auto& chunk : batch) {
+                    freeBuffers.push_back(chunk.data);
+                }
+                batch.clear();
+                condition.notify_all();
+            }
+        }
+
+        void handOver() {
+#ifdef STREAMS_HAS_IO_URING
+            if (ring) {
+                handOverAsync();
+                return;
+            }
+#endif
+            if (!options.background) {
+                Chunk chunk{ current, used };
+                used = 0;
+                if (int result = writeChunks(&chunk, 1)) {
+                    throw Detail::IOException{ result };
+                }
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock{ mutex };
+            pending.push_back({ current, used });
+            condition.notify_all();
+            if (freeBuffers.empty() && !error) {
+                Detail::TraceScope wait{ "queue full" };
+                condition.wait(lock, [this]() { return !freeBuffers.empty() || error; });
+            }
+            if (error) {
+                throw Detail::IOException{ error };
+            }
+
+            current = freeBuffers.back();
+            freeBuffers.pop_back();
+            used = 0;
+        }
+
+    public:
+        BufferedWriter(int f, WriteOptions o = {})
+            : fd{ f }, ownsFd{ false }, options{ o } {
+            allocateBuffers();
+        }
+
+        BufferedWriter(const std::filesystem::path& path, WriteOptions o = {})
+            : fd{ ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) }, ownsFd{ true }, options{ o } {
+            if (fd < 0) {
+                throw Detail::IOException{ errno };
+            }
+
+            try {
+                allocateBuffers();
+            }
+            catch (...) {
+                ::close(fd);
+                throw;
+            }
+        }
+
+        BufferedWriter(const BufferedWriter&) = delete;
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        ~BufferedWriter() {
+            try {
+                close();
+            }
+            catch (const Detail::IOException&) {}
+
+#ifdef STREAMS_HAS_IO_URING
+            // Writes that could not be reaped may still read from their buffers, so those are leaked rather than freed.
+            if (inFlight > 0) {
+                return;
+            }
+#endif
+            for (auto buffer : buffers) {
+                ::operator delete(buffer, std::align_val_t{ alignment });
+            }
+        }
+
+        char* reserve(std::size_t size) {
+            if (size > options.bufferSize) {
+                throw Detail::IOException{ ENOBUFS };
+            }
+            if (options.bufferSize - used < size) {
+                handOver();
+            }
+            return current + used;
+        }
+
+        void commit(std::size_t size) {
+            used += size;
+        }
+
+        void append(const char* data, std::size_t size) {
+            while (size) {
+                if (used == options.bufferSize) {
+                    handOver();
+                }
+
+                auto num = options.bufferSize - used < size ? options.bufferSize - used : size;
+                std::memcpy(current + used, data, num);
+                used += num;
+                data += num;
+                size -= num;
+            }
+        }
+
+        void append(std::string_view str) {
+            append(str.data(), str.size());
+        }
+
+        void append(char c) {
+            if (used == options.bufferSize) {
+                handOver();
+            }
+            current[used++] = c;
+        }
+
+        template<typename T>
+        void appendNumber(T value) {
+            auto begin = reserve(64);
+            auto result = std::to_chars(begin, begin + 64, value);
+            commit(static_cast<std::size_t>(result.ptr - begin));
+        }
+
+        void flush() {
+            if (used) {
+                handOver();
+            }
+        }
+
+        std::size_t close() {
+            if (isClosed) {
+                return bytesWritten;
+            }
+            isClosed = true;
+
+            int result = 0;
+            try {
+                flush();
+            }
+            catch (const Detail::IOException& e) {
+                result = e.error;
+            }
+
+            if (writerThread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock{ mutex };
+                    stopping = true;
+                }
+                condition.notify_all();
+                writerThread.join();
+                result = result ? result : error;
+            }
+
+#ifdef STREAMS_HAS_IO_URING
+            if (ring) {
+                int drained = drainRing();
+                result = result ? result : drained;
+            }
+#endif
+
+            if (!result && options.fsync == FsyncPolicy::OnClose) {
+                result = syncFile();
+            }
+
+            if (ownsFd && ::close(fd) != 0 && !result) {
+                result = errno;
+            }
+
+            if (result) {
+                throw Detail::IOException{ result };
+            }
+            return bytesWritten;
+        }
+    };
+#endif
+
+#ifdef STREAMS_HAS_POSIX
+    namespace Detail {
+        template<typename TIt, typename TTarget, typename TFormat>
+        std::size_t writeStream(TIt& it, const TTarget& target, TFormat& format, const WriteOptions& options) {
+            BufferedWriter writer{ target, options };
+            while (it.hasNext()) {
+                format(it.next(), writer);
+            }
+
+            return writer.close();
+        }
+    }
+#endif
+
+    inline auto jsonLines(const std::filesystem::path& path) {
+        auto file = std::make_shared<Detail::MappedFile>(path);
+        auto data = file->data();
+        auto size = file->size();
+        return JsonLinesStream{ Detail::move(file), data, data + size };
+    }
+
+#ifdef STREAMS_HAS_POSIX
+    class FileBlockIterator {
+        std::shared_ptr<Detail::FileReader> reader;
+
+    public:
+        FileBlockIterator(std::shared_ptr<Detail::FileReader> r)
+            : reader{ Detail::move(r) } {}
+
+        bool hasNext() {
+            return reader->hasNext();
+        }
+
+        int estimateRemaining() {
+            return static_cast<int>(reader->remaining() >> 20);
+        }
+
+        std::string_view next() {
+            return reader->next();
+        }
+    };
+
+    class FileBlockStream : public Stream<FileBlockIterator> {
+    public:
+        FileBlockStream(std::shared_ptr<Detail::FileReader> r)
+            : Stream<FileBlockIterator>{ FileBlockIterator{ Detail::move(r) } } {}
+    };
+
+    inline auto fileBlocks(const std::filesystem::path& path, ReadOptions options = {}) {
+        return FileBlockStream{ std::make_shared<Detail::FileReader>(path, options) };
+    }
+#endif
+
+#ifdef STREAMS_HAS_POSIX
+    template<typename TResync>
+    class LinesIterator;
+
+    namespace Detail {
+
+        // A resync returns the offset just past the end of the first record in window, or npos if no record ends in it.
+        struct NewlineResync {
+            std::size_t operator()(std::string_view window) const {
+                auto pos = window.find('\n');
+                return pos == std::string_view::npos ? pos : pos + 1;
+            }
+        };
+
+        // Pipes, FIFOs and sockets have no length, so they are read to the end as a single split.
+        class LineFile {
+            int fd;
+            std::uint64_t length{ 0 };
+            bool regular{ true };
+
+        public:
+            LineFile(const std::filesystem::path& path)
+                : fd{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) } {
+                struct stat info;
+                if (fd < 0 || ::fstat(fd, &info) != 0) {
+                    int error = errno;
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    throw IOException{ error };
+                }
+                regular = S_ISREG(info.st_mode);
+                length = regular ? static_cast<std::uint64_t>(info.st_size) : static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+            }
+
+            LineFile(const LineFile&) = delete;
+            LineFile& operator=(const LineFile&) = delete;
+
+            ~LineFile() {
+                ::close(fd);
+            }
+
+            int descriptor() const {
+                return fd;
+            }
+
+            std::uint64_t size() const {
+                return length;
+            }
+
+            bool isRegular() const {
+                return regular;
+            }
+        };
+
+        template<typename TResync>
+        class LineSource {
+            std::shared_ptr<LineFile> file;
+            ReadOptions options;
+            TResync resync;
+
+            std::uint64_t boundary(std::uint64_t pos) const {
+                if (pos == 0 || pos >= file->size()) {
+                    return pos < file->size() ? pos : file->size();
+                }
+
+                std::string window;
+                std::size_t windowSize = 4096;
+                while (true) {
+                    window.resize(windowSize);
+                    std::size_t numRead;
+                    if (int error = readFully(file->descriptor(), window.data(), windowSize, pos, numRead)) {
+                        throw IOException{ error };
+                    }
+
+                    auto offset = resync(std::string_view{ window.data(), numRead });
+                    if (offset != std::string_view::npos) {
+                        return pos + offset;
+                    }
+                    if (numRead < windowSize) {
+                        return file->size();
+                    }
+                    windowSize *= 2;
+                }
+            }
+
+        public:
+            static constexpr bool sized = false;
+
+            LineSource(std::shared_ptr<LineFile> f, ReadOptions o, TResync r)
+                : file{ Detail::move(f) }, options{ o }, resync{ r } {}
+
+            std::uint64_t size() const {
+                return file->size();
+            }
+
+            std::uint64_t grain() const {
+                return file->isRegular() ? 1 << 20 : file->size();
+            }
+
+            std::uint64_t minGrain() const {
+                return file->isRegular() ? 4096 : file->size();
+            }
+
+            std::size_t recordEnd(std::string_view window) const {
+                return resync(window);
+            }
+
+            LinesIterator<TResync> iterator(std::uint64_t begin, std::uint64_t end) const {
+                TraceScope trace{ "split", begin };
+                auto first = boundary(begin);
+                auto last = boundary(end);
+                auto reader = std::make_shared<FileReader>(file->descriptor(), options, first, last > first ? last : first);
+                if (begin != 0 || end != file->size()) {
+                    reader->prefetch();
+                }
+                return { *this, Detail::move(reader) };
+            }
+        };
+    }
+
+    template<typename TResync>
+    class LinesIterator {
+        Detail::LineSource<TResync> lineSource;
+        std::shared_ptr<Detail::FileReader> reader;
+        std::string_view block;
+        std::string carry;
+        std::string spill;
+
+        static std::string_view trim(std::string_view record) {
+            if (!record.empty() && record.back() == '\n') {
+                record.remove_suffix(1);
+            }
+            return record;
+        }
+
+    public:
+        LinesIterator(Detail::LineSource<TResync> s, std::shared_ptr<Detail::FileReader> r)
+            : lineSource{ Detail::move(s) }, reader{ Detail::move(r) } {}
+
+        bool hasNext() {
+            return !block.empty() || reader->hasNext();
+        }
+
+        int estimateRemaining() {
+            auto remaining = (block.size() + reader->remaining()) / 64;
+            return remaining < static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ? static_cast<int>(remaining) : std::numeric_limits<int>::max();
+        }
+
+        std::string_view next() {
+            carry.clear();
+            while (true) {
+                if (!block.empty()) {
+                    if (carry.empty()) {
+                        auto end = lineSource.recordEnd(block);
+                        if (end != std::string_view::npos) {
+                            auto record = block.substr(0, end);
+                            block.remove_prefix(end);
+                            return trim(record);
+                        }
+                        carry.assign(block.data(), block.size());
+                    }
+                    else {
+                        auto previous = carry.size();
+                        std::size_t taken = 0;
+                        while (taken < block.size()) {
+                            auto step = std::min(block.size() - taken, std::max<std::size_t>(256, taken));
+                            carry.append(block.data() + taken, step);
+                            taken += step;
+                            auto end = lineSource.recordEnd(carry);
+                            if (end == std::string_view::npos) {
+                                continue;
+                            }
+
+                            if (end >= previous) {
+                                block.remove_prefix(end - previous);
+                            }
+                            else {
+                                std::string rest{ carry.data() + end, carry.size() - end };
+                                rest.append(block.data() + taken, block.size() - taken);
+                                spill.swap(rest);
+                                block = spill;
+                            }
+                            carry.resize(end);
+                            return trim(carry);
+                        }
+                    }
+                }
+
+                if (!reader->hasNext()) {
+                    block = {};
+                    return trim(carry);
+                }
+                block = reader->next();
+            }
+        }
+
+        Detail::LineSource<TResync> source() const {
+            return lineSource;
+        }
+    };
+
+    template<typename TResync>
+    class LinesStream : public Stream<LinesIterator<TResync>> {
+    public:
+        LinesStream(Detail::LineSource<TResync> s)
+            : Stream<LinesIterator<TResync>>{ s.iterator(0, s.size()) } {}
+    };
+
+    template<typename TResync>
+    auto lines(const std::filesystem::path& path, TResync resync, ReadOptions options = {}) {
+        return LinesStream<TResync>{ Detail::LineSource<TResync>{ std::make_shared<Detail::LineFile>(path), options, resync } };
+    }
+
+    inline auto lines(const std::filesystem::path& path, ReadOptions options = {}) {
+        return lines(path, Detail::NewlineResync{}, options);
+    }
+#endif
+}
\ No newline at end of file
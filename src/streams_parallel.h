@@ -0,0 +1,1542 @@
+﻿#pragma once
+
+#include "streams_profile.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef STREAMS_HAS_AFFINITY
+#include <sched.h>
+#endif
+
+namespace Stream {
+
+    namespace Detail {
+#ifdef STREAMS_ENABLE_TRACING
+        struct TraceEvent {
+            const char* name;
+            char phase;
+            std::uint64_t ticks;
+            std::uint64_t arg;
+        };
+
+        // The owning thread appends under the buffer mutex, so reset() and traceJson() can run while workers are still tracing.
+        struct TraceBuffer {
+            std::uint32_t threadId;
+            std::mutex mutex;
+            std::vector<TraceEvent> events;
+        };
+
+        class TraceRegistry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<TraceBuffer>> buffers;
+            std::uint32_t nextThreadId{ 1 };
+
+        public:
+            std::atomic<bool> active{ false };
+            std::uint64_t epoch{ 0 };
+
+            static TraceRegistry& get() {
+                static TraceRegistry registry;
+                return registry;
+            }
+
+            std::shared_ptr<TraceBuffer> attach() {
+                auto buffer = std::make_shared<TraceBuffer>();
+                buffer->events.reserve(1 << 14);
+
+                std::lock_guard<std::mutex> lock{ mutex };
+                buffer->threadId = nextThreadId++;
+                buffers.push_back(buffer);
+                return buffer;
+            }
+
+            void reset() {
+                std::lock_guard<std::mutex> lock{ mutex };
+                std::size_t kept = 0;
+                for (auto& buffer : buffers) {
+                    if (buffer.use_count() > 1) {
+                        std::lock_guard<std::mutex> bufferLock{ buffer->mutex };
+                        buffer->events.clear();
+                        buffers[kept++] = Detail::move(buffer);
+                    }
+                }
+                buffers.resize(kept);
+                epoch = readTicks();
+            }
+
+            template<typename TFunc>
+            void forEachBuffer(TFunc func) {
+                std::lock_guard<std::mutex> lock{ mutex };
+                for (auto& buffer : buffers) {
+                    std::lock_guard<std::mutex> bufferLock{ buffer->mutex };
+                    func(*buffer);
+                }
+            }
+        };
+
+        inline TraceBuffer& traceBuffer() {
+            thread_local std::shared_ptr<TraceBuffer> buffer = TraceRegistry::get().attach();
+            return *buffer;
+        }
+
+        inline void traceEvent(const char* name, char phase, std::uint64_t arg = 0) {
+            if (TraceRegistry::get().active.load(std::memory_order_relaxed)) {
+                auto ticks = readTicks();
+                auto& buffer = traceBuffer();
+                std::lock_guard<std::mutex> lock{ buffer.mutex };
+                buffer.events.push_back({ name, phase, ticks, arg });
+            }
+        }
+#else
+        inline void traceEvent(const char*, char, std::uint64_t = 0) {}
+#endif
+
+        class TraceScope {
+#ifdef STREAMS_ENABLE_TRACING
+            const char* name;
+            std::uint64_t arg;
+#endif
+
+        public:
+#ifdef STREAMS_ENABLE_TRACING
+            TraceScope(const char* n, std::uint64_t a = 0)
+                : name{ n }, arg{ a } {
+                traceEvent(name, 'B', arg);
+            }
+
+            ~TraceScope() {
+                traceEvent(name, 'E', arg);
+            }
+#else
+            TraceScope(const char*, std::uint64_t = 0) {}
+#endif
+
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+        };
+    }
+
+    namespace Detail {
+
+        inline int resolveThreadCount(int threads) {
+            if (threads > 0) {
+                return threads;
+            }
+
+            auto hardwareThreads = std::thread::hardware_concurrency();
+            return hardwareThreads ? static_cast<int>(hardwareThreads) : 1;
+        }
+    }
+
+    class Executor {
+    public:
+        virtual ~Executor() = default;
+
+        virtual int concurrency() const = 0;
+
+        virtual void submit(std::function<void()> task) = 0;
+    };
+
+    template<typename TSubmit>
+    class ExecutorAdapter : public Executor {
+        int threads;
+        TSubmit submitTask;
+
+    public:
+        ExecutorAdapter(int t, TSubmit s)
+            : threads{ t }, submitTask{ Detail::move(s) } {}
+
+        int concurrency() const override {
+            return threads;
+        }
+
+        void submit(std::function<void()> task) override {
+            submitTask(Detail::move(task));
+        }
+    };
+
+    template<typename TSubmit>
+    auto adaptExecutor(int threads, TSubmit submit) {
+        return std::make_shared<ExecutorAdapter<TSubmit>>(threads, Detail::move(submit));
+    }
+
+    struct ThreadPoolOptions {
+        int threads{ 0 };
+        std::vector<int> cpus;
+        std::vector<int> numaNodes;
+    };
+
+    namespace Detail {
+
+        inline std::vector<int> parseCpuList(std::string_view list) {
+            std::vector<int> cpus;
+            while (!list.empty()) {
+                auto comma = list.find(',');
+                auto range = list.substr(0, comma);
+                list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+                int first = 0;
+                int last = 0;
+                auto end = range.data() + range.size();
+                auto parsed = std::from_chars(range.data(), end, first);
+                if (parsed.ec != std::errc{}) {
+                    continue;
+                }
+                last = first;
+                if (parsed.ptr != end && *parsed.ptr == '-') {
+                    std::from_chars(parsed.ptr + 1, end, last);
+                }
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        inline std::vector<int> numaNodeCpus(int node) {
+            auto path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            std::FILE* file = std::fopen(path.c_str(), "r");
+            if (!file) {
+                return {};
+            }
+
+            char buffer[4096];
+            auto num = std::fread(buffer, 1, sizeof(buffer), file);
+            std::fclose(file);
+            while (num && (buffer[num - 1] == '\n' || buffer[num - 1] == ' ')) {
+                num--;
+            }
+            return parseCpuList({ buffer, num });
+        }
+
+        inline bool pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef STREAMS_HAS_AFFINITY
+            if (cpus.empty()) {
+                return false;
+            }
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+            (void)cpus;
+            return false;
+#endif
+        }
+    }
+
+    class ThreadPool : public Executor {
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        std::atomic<long> queued{ 0 };
+        std::atomic<std::size_t> nextQueue{ 0 };
+        bool stopping{ false };
+
+        struct WorkerContext {
+            const ThreadPool* pool{ nullptr };
+            std::size_t idx{ 0 };
+        };
+
+        static WorkerContext& currentWorker() {
+            static thread_local WorkerContext context;
+            return context;
+        }
+
+        bool tryPop(std::size_t idx, std::function<void()>& task) {
+            {
+                auto& own = *queues[idx];
+                std::lock_guard<std::mutex> lock{ own.mutex };
+                if (!own.tasks.empty()) {
+                    task = Detail::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+
+            for (std::size_t i = 1; i < queues.size(); i++) {
+                auto victimIdx = (idx + i) % queues.size();
+                {
+                    auto& victim = *queues[victimIdx];
+                    std::lock_guard<std::mutex> lock{ victim.mutex };
+                    if (victim.tasks.empty()) {
+                        continue;
+                    }
+                    task = Detail::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                }
+                Detail::traceEvent("steal", 'i', victimIdx);
+                return true;
+            }
+            return false;
+        }
+
+        void runWorker(std::size_t idx, std::vector<int> cpus) {
+            Detail::pinCurrentThread(cpus);
+            currentWorker() = { this, idx };
+
+            std::function<void()> task;
+            while (true) {
+                if (tryPop(idx, task)) {
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    task();
+                    task = nullptr;
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock{ sleepMutex };
+                wakeUp.wait(lock, [this]() { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+                if (stopping && queued.load(std::memory_order_relaxed) <= 0) {
+                    return;
+                }
+            }
+        }
+
+    public:
+        ThreadPool(ThreadPoolOptions options = {}) {
+            auto numThreads = static_cast<std::size_t>(Detail::resolveThreadCount(options.threads));
+            for (std::size_t i = 0; i < numThreads; i++) {
+                queues.push_back(std::make_unique<Queue>());
+            }
+
+            for (std::size_t i = 0; i < numThreads; i++) {
+                std::vector<int> cpus;
+                if (!options.cpus.empty()) {
+                    cpus.push_back(options.cpus[i % options.cpus.size()]);
+                }
+                else if (!options.numaNodes.empty()) {
+                    cpus = Detail::numaNodeCpus(options.numaNodes[i % options.numaNodes.size()]);
+                }
+                threads.emplace_back([this, i, cpus]() { runWorker(i, cpus); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock{ sleepMutex };
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        int concurrency() const override {
+            return static_cast<int>(threads.size());
+        }
+
+        void submit(std::function<void()> task) override {
+            auto& context = currentWorker();
+            auto idx = context.pool == this ? context.idx : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+            {
+                auto& queue = *queues[idx];
+                std::lock_guard<std::mutex> lock{ queue.mutex };
+                queue.tasks.push_back(Detail::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock{ sleepMutex };
+                queued.fetch_add(1, std::memory_order_relaxed);
+            }
+            wakeUp.notify_one();
+        }
+    };
+
+    namespace Detail {
+
+        inline std::mutex& defaultExecutorMutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        inline std::shared_ptr<Executor>& defaultExecutorSlot() {
+            static std::shared_ptr<Executor> executor;
+            return executor;
+        }
+    }
+
+    inline std::shared_ptr<Executor> defaultExecutor() {
+        std::lock_guard<std::mutex> lock{ Detail::defaultExecutorMutex() };
+        auto& executor = Detail::defaultExecutorSlot();
+        if (!executor) {
+            executor = std::make_shared<ThreadPool>();
+        }
+        return executor;
+    }
+
+    inline void setDefaultExecutor(std::shared_ptr<Executor> executor) {
+        std::lock_guard<std::mutex> lock{ Detail::defaultExecutorMutex() };
+        Detail::defaultExecutorSlot() = Detail::move(executor);
+    }
+
+    namespace Detail {
+
+        class Cancellation {
+            std::atomic<std::uint64_t> cutoff{ std::numeric_limits<std::uint64_t>::max() };
+
+        public:
+            void reset() {
+                cutoff.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+            }
+
+            bool isCancelled(std::uint64_t begin) const {
+                return begin >= cutoff.load(std::memory_order_relaxed);
+            }
+
+            void cancelAll() {
+                cutoff.store(0, std::memory_order_relaxed);
+            }
+
+            void cancelAfter(std::uint64_t begin) {
+                auto current = cutoff.load(std::memory_order_relaxed);
+                while (begin + 1 < current && !cutoff.compare_exchange_weak(current, begin + 1, std::memory_order_relaxed)) {}
+            }
+        };
+
+        struct ParallelConfig {
+            std::shared_ptr<Executor> executor;
+            int threadCount{ 1 };
+            bool ordered{ true };
+            RunReport* report{ nullptr };
+            std::shared_ptr<Cancellation> cancellation;
+            std::uint64_t deterministicBlock{ 0 };
+        };
+    }
+
+    namespace Detail {
+
+        struct IdentityStage {
+            template<typename TIt>
+            TIt operator()(TIt it) const {
+                return it;
+            }
+
+            IdentityStage start(const std::shared_ptr<Cancellation>&) const {
+                return *this;
+            }
+        };
+
+        template<typename TLam>
+        const TLam& startStage(const TLam& lambda, const std::shared_ptr<Cancellation>&) {
+            return lambda;
+        }
+
+        struct LimitState;
+
+        inline std::shared_ptr<LimitState> startStage(const std::shared_ptr<LimitState>& state, const std::shared_ptr<Cancellation>& cancellation);
+
+        template<template<typename, typename> class TIterator, typename TPrev, typename TLam>
+        struct LambdaStage {
+            TPrev prev;
+            TLam lambda;
+
+            template<typename TIt>
+            auto operator()(TIt it) const {
+                auto inner = prev(Detail::move(it));
+                return TIterator<decltype(inner), TLam>{ Detail::move(inner), lambda };
+            }
+
+            // Stages that share state between chunks get a fresh copy of it for every run
+            LambdaStage start(const std::shared_ptr<Cancellation>& cancellation) const {
+                return LambdaStage{ prev.start(cancellation), startStage(lambda, cancellation) };
+            }
+        };
+
+        template<typename TIt>
+        class RangeSource {
+            TIt first;
+            std::uint64_t count;
+
+        public:
+            static constexpr bool sized = true;
+
+            RangeSource(TIt b, TIt e)
+                : first{ b }, count{ static_cast<std::uint64_t>(e - b) } {}
+
+            std::uint64_t size() const {
+                return count;
+            }
+
+            std::uint64_t grain() const {
+                return 16;
+            }
+
+            std::uint64_t minGrain() const {
+                return 1;
+            }
+
+            StreamIterator<TIt> iterator(std::uint64_t begin, std::uint64_t end) const {
+                return { first + static_cast<std::ptrdiff_t>(begin), first + static_cast<std::ptrdiff_t>(end) };
+            }
+        };
+
+        template<typename T, typename TDist>
+        class RandomSource {
+            Philox generator;
+            TDist distribution;
+            std::uint64_t first;
+            std::uint64_t count;
+
+        public:
+            static constexpr bool sized = true;
+
+            RandomSource(Philox g, TDist dist, std::uint64_t b, std::uint64_t e)
+                : generator{ g }, distribution{ Detail::move(dist) }, first{ b }, count{ e - b } {}
+
+            std::uint64_t size() const {
+                return count;
+            }
+
+            std::uint64_t grain() const {
+                return 64;
+            }
+
+            std::uint64_t minGrain() const {
+                return 1;
+            }
+
+            RandomIterator<T, TDist> iterator(std::uint64_t begin, std::uint64_t end) const {
+                return { generator, distribution, first + begin, first + end };
+            }
+        };
+
+        template<typename TSource>
+        class TruncatedSource {
+            TSource source;
+            std::uint64_t count;
+
+        public:
+            static constexpr bool sized = TSource::sized;
+
+            TruncatedSource(TSource s, std::uint64_t maxCount)
+                : source{ Detail::move(s) }, count{ source.size() < maxCount ? source.size() : maxCount } {}
+
+            std::uint64_t size() const {
+                return count;
+            }
+
+            std::uint64_t grain() const {
+                return source.grain();
+            }
+
+            std::uint64_t minGrain() const {
+                return source.minGrain();
+            }
+
+            auto iterator(std::uint64_t begin, std::uint64_t end) const {
+                return source.iterator(begin, end);
+            }
+        };
+
+        struct LimitState {
+            std::int64_t count{ 0 };
+            std::atomic<std::int64_t> remaining{ 0 };
+            std::shared_ptr<Cancellation> cancellation;
+        };
+
+        inline std::shared_ptr<LimitState> startStage(const std::shared_ptr<LimitState>& state, const std::shared_ptr<Cancellation>& cancellation) {
+            auto fresh = std::make_shared<LimitState>();
+            fresh->count = state->count;
+            fresh->remaining.store(state->count, std::memory_order_relaxed);
+            fresh->cancellation = cancellation;
+            return fresh;
+        }
+
+        class GrainSizer {
+            std::uint64_t grain;
+            std::uint64_t minGrain;
+            std::uint64_t targetTicks;
+
+        public:
+            GrainSizer(std::uint64_t g, std::uint64_t minG, std::uint64_t ticks)
+                : grain{ g > minG ? g : minG }, minGrain{ minG }, targetTicks{ ticks } {}
+
+            std::uint64_t next(std::uint64_t remaining, std::size_t numWorkers) const {
+                auto share = remaining / (2 * numWorkers);
+                share = share > minGrain ? share : minGrain;
+                return grain < share ? grain : share;
+            }
+
+            void record(std::uint64_t items, std::uint64_t ticks) {
+                auto ideal = ticks ? items * targetTicks / ticks : grain * 2;
+                ideal = ideal < grain * 2 ? ideal : grain * 2;
+                ideal = ideal > grain / 2 ? ideal : grain / 2;
+                grain = ideal > minGrain ? ideal : minGrain;
+            }
+        };
+
+        template<typename TBody>
+        void runSplits(Executor& executor, int threadCount, std::uint64_t size, std::uint64_t grain, std::uint64_t minGrain, TBody& body, const Cancellation& cancellation, RunReport* report = nullptr) {
+            std::atomic<std::uint64_t> cursor{ 0 };
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            // The source grain is only the starting chunk size; chunks shrink towards minGrain when elements are expensive
+            minGrain = minGrain ? minGrain : 1;
+            auto maxSplits = (size + minGrain - 1) / minGrain;
+            maxSplits = maxSplits ? maxSplits : 1;
+            auto numWorkers = static_cast<std::uint64_t>(threadCount) < maxSplits ? static_cast<std::size_t>(threadCount) : static_cast<std::size_t>(maxSplits);
+            auto targetTicks = static_cast<std::uint64_t>(STREAMS_CHUNK_NANOSECONDS * ticksPerNanosecond());
+            auto begin = readTicks();
+            std::atomic<std::uint64_t> allocations{ 0 };
+            std::atomic<std::uint64_t> bytes{ 0 };
+            if (report) {
+                report->threads.assign(numWorkers, HardwareCounters{});
+            }
+
+            auto work = [&](std::size_t workerIdx) {
+                TraceScope trace{ "worker", workerIdx };
+                std::unique_ptr<PerfCounters> counters;
+                if (report) {
+                    counters = std::make_unique<PerfCounters>();
+                    counters->start();
+                }
+                auto workerAllocations = allocationCount();
+                auto workerBytes = allocatedBytes();
+
+                GrainSizer sizer{ grain, minGrain, targetTicks };
+                while (!failed.load(std::memory_order_relaxed)) {
+                    auto claimed = cursor.load(std::memory_order_relaxed);
+                    auto step = sizer.next(claimed < size ? size - claimed : 0, numWorkers);
+                    auto begin = cursor.fetch_add(step, std::memory_order_relaxed);
+                    if (begin >= size || cancellation.isCancelled(begin)) {
+                        break;
+                    }
+
+                    auto end = size - begin > step ? begin + step : size;
+                    try {
+                        TraceScope trace{ "chunk", begin };
+                        auto chunkBegin = readTicks();
+                        body(begin, end);
+                        sizer.record(end - begin, readTicks() - chunkBegin);
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock{ errorMutex };
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+
+                if (counters) {
+                    counters->stop();
+                    report->threads[workerIdx] = counters->read();
+                    allocations.fetch_add(allocationCount() - workerAllocations, std::memory_order_relaxed);
+                    bytes.fetch_add(allocatedBytes() - workerBytes, std::memory_order_relaxed);
+                }
+            };
+
+            struct Helpers {
+                std::mutex mutex;
+                std::condition_variable done;
+                int active{ 0 };
+                bool closed{ false };
+            };
+
+            auto helpers = std::make_shared<Helpers>();
+            for (std::size_t i = 1; i < numWorkers; i++) {
+                executor.submit([helpers, &work, i]() {
+                    {
+                        std::lock_guard<std::mutex> lock{ helpers->mutex };
+                        if (helpers->closed) {
+                            return;
+                        }
+                        helpers->active++;
+                    }
+                    work(i);
+                    std::lock_guard<std::mutex> lock{ helpers->mutex };
+                    if (--helpers->active == 0) {
+                        helpers->done.notify_all();
+                    }
+                });
+            }
+            work(0);
+
+            {
+                std::unique_lock<std::mutex> lock{ helpers->mutex };
+                helpers->closed = true;
+                helpers->done.wait(lock, [&]() { return helpers->active == 0; });
+            }
+
+            if (report) {
+                report->nanoseconds = ticksToNanoseconds(readTicks() - begin);
+                report->allocations = allocations.load();
+                report->allocatedBytes = bytes.load();
+                report->counters = HardwareCounters{};
+                for (auto& counters : report->threads) {
+                    report->counters += counters;
+                }
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    namespace Detail {
+
+        template<typename TContainer, typename = void>
+        struct IsResizable : std::false_type {};
+
+        template<typename TContainer>
+        struct IsResizable<TContainer, std::void_t<decltype(std::declval<TContainer&>().resize(std::size_t{})), decltype(std::declval<TContainer&>()[std::size_t{}])>>
+            : std::is_default_constructible<typename TContainer::value_type> {};
+
+        template<typename TContainer>
+        inline constexpr bool isResizable = IsResizable<TContainer>::value;
+
+        template<typename TContainer, typename = void>
+        struct HasReserve : std::false_type {};
+
+        template<typename TContainer>
+        struct HasReserve<TContainer, std::void_t<decltype(std::declval<TContainer&>().reserve(std::size_t{}))>> : std::true_type {};
+
+        template<typename T>
+        void atomicAdd(std::atomic<T>& target, T value) {
+            if constexpr (std::is_integral_v<T>) {
+                target.fetch_add(value, std::memory_order_relaxed);
+            }
+            else {
+                auto current = target.load(std::memory_order_relaxed);
+                while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+            }
+        }
+
+        inline std::uint64_t mixHash(std::uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+        template<typename TKey, typename TAggregate>
+        class ConcurrentTable {
+            static_assert(std::is_arithmetic_v<TAggregate>, "concurrent aggregation requires an arithmetic collector");
+
+            enum : std::uint8_t { Empty, Busy, Full };
+
+            struct Slot {
+                std::atomic<std::uint8_t> state{ Empty };
+                std::uint64_t hash{ 0 };
+                TypedStorage<TKey> key;
+                std::atomic<TAggregate> aggregate{ TAggregate{} };
+            };
+
+            std::unique_ptr<Slot[]> slots;
+            std::size_t mask;
+            std::size_t maxCount;
+            std::atomic<std::size_t> count{ 0 };
+
+        public:
+            ConcurrentTable(std::size_t expectedKeys) {
+                std::size_t capacity = 64;
+                while (capacity < expectedKeys * 2) {
+                    capacity *= 2;
+                }
+                slots = std::make_unique<Slot[]>(capacity);
+                mask = capacity - 1;
+                maxCount = capacity / 4 * 3;
+            }
+
+            ConcurrentTable(const ConcurrentTable&) = delete;
+            ConcurrentTable& operator=(const ConcurrentTable&) = delete;
+
+            ~ConcurrentTable() {
+                for (std::size_t i = 0; i <= mask; i++) {
+                    if (slots[i].state.load(std::memory_order_relaxed) == Full) {
+                        slots[i].key.destruct();
+                    }
+                }
+            }
+
+            std::atomic<TAggregate>* find(const TKey& key) {
+                auto hash = mixHash(static_cast<std::uint64_t>(std::hash<TKey>{}(key)));
+                for (auto idx = static_cast<std::size_t>(hash) & mask;; idx = (idx + 1) & mask) {
+                    auto& slot = slots[idx];
+                    auto state = slot.state.load(std::memory_order_acquire);
+                    if (state == Empty) {
+                        if (count.load(std::memory_order_relaxed) >= maxCount) {
+                            return nullptr;
+                        }
+                        if (slot.state.compare_exchange_strong(state, Busy, std::memory_order_acquire)) {
+                            count.fetch_add(1, std::memory_order_relaxed);
+                            slot.hash = hash;
+                            slot.key.construct(key);
+                            slot.state.store(Full, std::memory_order_release);
+                            return &slot.aggregate;
+                        }
+                    }
+
+                    while (state == Busy) {
+                        std::this_thread::yield();
+                        state = slot.state.load(std::memory_order_acquire);
+                    }
+                    if (slot.hash == hash && slot.key.get() == key) {
+                        return &slot.aggregate;
+                    }
+                }
+            }
+
+            std::size_t size() const {
+                return count.load(std::memory_order_relaxed);
+            }
+
+            template<typename TFunc>
+            void forEach(TFunc f) {
+                for (std::size_t i = 0; i <= mask; i++) {
+                    if (slots[i].state.load(std::memory_order_acquire) == Full) {
+                        f(slots[i].key.get(), slots[i].aggregate.load(std::memory_order_relaxed));
+                    }
+                }
+            }
+        };
+
+        inline constexpr std::uint64_t concurrentSampleItems = 4096;
+        inline constexpr std::uint64_t concurrentMinKeys = 1 << 14;
+
+        template<typename T>
+        class ChunkResults {
+            std::mutex mutex;
+            std::vector<std::pair<std::uint64_t, T>> results;
+
+        public:
+            void add(std::uint64_t begin, T value) {
+                std::lock_guard<std::mutex> lock{ mutex };
+                results.emplace_back(begin, Detail::move(value));
+            }
+
+            std::vector<std::pair<std::uint64_t, T>>& sorted() {
+                std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                return results;
+            }
+        };
+    }
+
+    template<typename TStreamIt, typename TState>
+    class SharedLimitIterator {
+        TStreamIt it;
+        TState state;
+        bool claimed{ false };
+
+    public:
+        SharedLimitIterator(TStreamIt i, TState s)
+            : it{ Detail::move(i) }, state{ Detail::move(s) } {}
+
+        bool hasNext() {
+            if (claimed) {
+                return true;
+            }
+            if (!it.hasNext()) {
+                return false;
+            }
+            if (state->remaining.fetch_sub(1, std::memory_order_relaxed) <= 0) {
+                state->cancellation->cancelAll();
+                return false;
+            }
+
+            claimed = true;
+            return true;
+        }
+
+        int estimateRemaining() {
+            return it.estimateRemaining();
+        }
+
+        auto next() {
+            claimed = false;
+            return it.next();
+        }
+    };
+
+    template<typename TSource, typename TStages, bool sized>
+    class ParallelStream {
+        TSource source;
+        TStages stages;
+        Detail::ParallelConfig config;
+
+        using TChainIterator = decltype(std::declval<const TStages&>()(std::declval<const TSource&>().iterator(0, 0)));
+        using TValue = decltype(std::declval<TChainIterator&>().next());
+
+        template<template<typename, typename> class TIterator, bool keepsSize, typename TLam>
+        auto addStage(TLam lambda) {
+            using TNextStages = Detail::LambdaStage<TIterator, TStages, TLam>;
+            return ParallelStream<TSource, TNextStages, sized && keepsSize>{ source, TNextStages{ stages, lambda }, config };
+        }
+
+        template<typename TBody>
+        void run(TBody body) {
+            auto size = source.size();
+            Detail::TraceScope trace{ "run", size };
+            config.cancellation->reset();
+            auto chain = stages.start(config.cancellation);
+            auto work = [&](std::uint64_t begin, std::uint64_t end) {
+                auto it = chain(source.iterator(begin, end));
+                if constexpr (std::is_invocable_v<TBody&, std::uint64_t, std::uint64_t, TChainIterator&>) {
+                    body(begin, end, it);
+                }
+                else {
+                    body(begin, it);
+                }
+            };
+            Detail::runSplits(*config.executor, config.threadCount, size, source.grain(), source.minGrain(), work, *config.cancellation, config.report);
+        }
+
+        template<typename TKey, typename TAggregate, typename TKeyFunc, typename TValueFunc>
+        std::unordered_map<TKey, TAggregate> aggregate(TKeyFunc keyFn, TValueFunc valueFn) {
+            using TLocal = std::unordered_map<TKey, TAggregate>;
+            enum Mode { Undecided, Local, Concurrent };
+
+            std::atomic<int> mode{ Undecided };
+            std::unique_ptr<Detail::ConcurrentTable<TKey, TAggregate>> shared;
+            TLocal result;
+            std::mutex mutex;
+
+            auto merge = [&](TLocal& local) {
+                if (local.empty()) {
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock{ mutex };
+                for (auto& entry : local) {
+                    result[entry.first] += entry.second;
+                }
+            };
+
+            run([&](std::uint64_t begin, std::uint64_t end, TChainIterator& it) {
+                TLocal local;
+                if (mode.load(std::memory_order_acquire) == Concurrent) {
+                    while (it.hasNext()) {
+                        auto x = it.next();
+                        auto key = keyFn(x);
+                        if (auto slot = shared->find(key)) {
+                            Detail::atomicAdd(*slot, static_cast<TAggregate>(valueFn(x)));
+                        }
+                        else {
+                            local[Detail::move(key)] += valueFn(x);
+                        }
+                    }
+                    merge(local);
+                    return;
+                }
+
+                std::uint64_t items = 0;
+                while (it.hasNext()) {
+                    auto x = it.next();
+                    local[keyFn(x)] += valueFn(x);
+                    items++;
+                }
+
+                if (items >= Detail::concurrentSampleItems && mode.load(std::memory_order_relaxed) == Undecided) {
+                    std::lock_guard<std::mutex> lock{ mutex };
+                    if (mode.load(std::memory_order_relaxed) == Undecided) {
+                        auto estimatedKeys = local.size() * source.size() / (end - begin);
+                        if (local.size() * 2 >= items && estimatedKeys >= Detail::concurrentMinKeys) {
+                            shared = std::make_unique<Detail::ConcurrentTable<TKey, TAggregate>>(static_cast<std::size_t>(estimatedKeys));
+                            mode.store(Concurrent, std::memory_order_release);
+                        }
+                        else {
+                            mode.store(Local, std::memory_order_release);
+                        }
+                    }
+                }
+                merge(local);
+            });
+
+            if (shared) {
+                result.reserve(result.size() + shared->size());
+                shared->forEach([&](const TKey& key, TAggregate value) {
+                    result[key] += value;
+                });
+            }
+            return result;
+        }
+
+        template<typename TAccu, typename TBlock, typename TCombine>
+        TAccu reduceBlocks(TAccu identity, TBlock block, TCombine combine) {
+            auto size = source.size();
+            auto grain = source.grain();
+            auto blockSize = config.deterministicBlock > grain ? config.deterministicBlock : grain;
+            auto numBlocks = (size + blockSize - 1) / blockSize;
+            if (!numBlocks) {
+                return identity;
+            }
+
+            std::vector<TAccu> blocks(static_cast<std::size_t>(numBlocks), identity);
+            auto chain = stages.start(config.cancellation);
+            auto work = [&](std::uint64_t begin, std::uint64_t end) {
+                for (auto idx = begin; idx < end; idx++) {
+                    auto blockEnd = (idx + 1) * blockSize;
+                    auto it = chain(source.iterator(idx * blockSize, blockEnd < size ? blockEnd : size));
+                    block(it, blocks[static_cast<std::size_t>(idx)]);
+                }
+            };
+
+            Detail::TraceScope trace{ "run", size };
+            config.cancellation->reset();
+            Detail::runSplits(*config.executor, config.threadCount, numBlocks, 1, 1, work, *config.cancellation, config.report);
+
+            for (std::size_t width = 1; width < blocks.size(); width *= 2) {
+                for (std::size_t i = 0; i + width < blocks.size(); i += 2 * width) {
+                    blocks[i] = combine(blocks[i + width], blocks[i]);
+                }
+            }
+            return Detail::move(blocks[0]);
+        }
+
+    public:
+        ParallelStream(TSource src, TStages st, Detail::ParallelConfig c)
+            : source{ Detail::move(src) }, stages{ Detail::move(st) }, config{ Detail::move(c) } {}
+
+        template<typename TLam>
+        auto map(TLam lambda) {
+            return addStage<MapIterator, true>(lambda);
+        }
+
+        template<typename TLam>
+        auto flatMap(TLam lambda) {
+            return addStage<FlatMapIterator, false>(lambda);
+        }
+
+        template<typename TLam>
+        auto filter(TLam lambda) {
+            return addStage<FilterIterator, false>(lambda);
+        }
+
+        template<typename TLam>
+        auto tap(TLam lambda) {
+            return addStage<TapIterator, true>(lambda);
+        }
+
+        // After filter() or flatMap() the size is unknown, so limit() keeps whichever elements the workers claim first and the
+        // stream becomes unordered(); limit a sequential stream when the first elements in source order are needed.
+        auto limit(int size) {
+            auto count = static_cast<std::uint64_t>(size > 0 ? size : 0);
+            if constexpr (sized) {
+                using TLimitedSource = Detail::TruncatedSource<TSource>;
+                return ParallelStream<TLimitedSource, TStages, sized>{ TLimitedSource{ source, count }, stages, config };
+            }
+            else {
+                auto state = std::make_shared<Detail::LimitState>();
+                state->count = static_cast<std::int64_t>(count);
+                return addStage<SharedLimitIterator, false>(Detail::move(state)).unordered();
+            }
+        }
+
+        auto unordered() {
+            auto c = config;
+            c.ordered = false;
+            return ParallelStream{ source, stages, Detail::move(c) };
+        }
+
+        auto deterministic(std::uint64_t blockSize = 4096) {
+            auto c = config;
+            c.deterministicBlock = blockSize ? blockSize : 1;
+            return ParallelStream{ source, stages, Detail::move(c) };
+        }
+
+        auto withReport(RunReport& runReport) {
+            auto c = config;
+            c.report = &runReport;
+            return ParallelStream{ source, stages, Detail::move(c) };
+        }
+
+        void sink() {
+            run([](std::uint64_t, TChainIterator& it) {
+                while (it.hasNext()) {
+                    it.next();
+                }
+            });
+        }
+
+        template<typename TFunc>
+        void forEach(TFunc f) {
+            run([&](std::uint64_t, TChainIterator& it) {
+                while (it.hasNext()) {
+                    f(it.next());
+                }
+            });
+        }
+
+        template<typename TFunc, typename TAccu, typename TCombine>
+        TAccu reduce(TFunc f, TAccu accu, TCombine combine, TAccu identity) {
+            auto block = [&](TChainIterator& it, TAccu& result) {
+                while (it.hasNext()) {
+                    result = f(it.next(), result);
+                }
+            };
+
+            if (config.deterministicBlock) {
+                return combine(reduceBlocks(identity, block, combine), accu);
+            }
+
+            Detail::ChunkResults<TAccu> results;
+            run([&](std::uint64_t begin, TChainIterator& it) {
+                auto result = identity;
+                block(it, result);
+                results.add(begin, Detail::move(result));
+            });
+
+            for (auto& result : results.sorted()) {
+                accu = combine(result.second, accu);
+            }
+            return accu;
+        }
+
+        template<typename TFunc, typename TAccu, typename... TCombine>
+        TAccu reduce(TFunc, TAccu accu, TCombine...) {
+            static_assert(sizeof...(TCombine) > 2, "parallel reduce() requires a combiner and its identity: reduce(f, accu, combine, identity)");
+            return accu;
+        }
+
+        double sumPrecise() {
+            auto block = [](TChainIterator& it, Detail::PreciseSum& sum) {
+                sum.addAll(it);
+            };
+            auto combine = [](Detail::PreciseSum a, Detail::PreciseSum b) {
+                b.merge(a);
+                return b;
+            };
+
+            if (config.deterministicBlock) {
+                return reduceBlocks(Detail::PreciseSum{}, block, combine).result();
+            }
+
+            Detail::ChunkResults<Detail::PreciseSum> results;
+            run([&](std::uint64_t begin, TChainIterator& it) {
+                Detail::PreciseSum sum;
+                block(it, sum);
+                results.add(begin, sum);
+            });
+
+            Detail::PreciseSum total;
+            for (auto& result : results.sorted()) {
+                total.merge(result.second);
+            }
+            return total.result();
+        }
+
+        template<typename TFunc>
+        bool allMatch(TFunc f) {
+            std::atomic<bool> result{ true };
+            run([&](std::uint64_t, TChainIterator& it) {
+                while (result.load(std::memory_order_relaxed) && it.hasNext()) {
+                    if (!f(it.next())) {
+                        result.store(false, std::memory_order_relaxed);
+                        config.cancellation->cancelAll();
+                    }
+                }
+            });
+            return result.load();
+        }
+
+        template<typename TFunc>
+        bool anyMatch(TFunc f) {
+            std::atomic<bool> result{ false };
+            run([&](std::uint64_t, TChainIterator& it) {
+                while (!result.load(std::memory_order_relaxed) && it.hasNext()) {
+                    if (f(it.next())) {
+                        result.store(true, std::memory_order_relaxed);
+                        config.cancellation->cancelAll();
+                    }
+                }
+            });
+            return result.load();
+        }
+
+        template<typename TFunc>
+        auto findFirst(TFunc f) {
+            std::optional<TValue> result;
+            std::uint64_t resultBegin = std::numeric_limits<std::uint64_t>::max();
+            std::mutex mutex;
+
+            run([&](std::uint64_t begin, TChainIterator& it) {
+                while (!config.cancellation->isCancelled(begin) && it.hasNext()) {
+                    auto x = it.next();
+                    if (!f(x)) {
+                        continue;
+                    }
+
+                    std::lock_guard<std::mutex> lock{ mutex };
+                    if (begin < resultBegin) {
+                        resultBegin = begin;
+                        result.emplace(Detail::move(x));
+                    }
+                    config.cancellation->cancelAfter(begin);
+                    return;
+                }
+            });
+            return result;
+        }
+
+        int count() {
+            return count([](const auto&) { return true; });
+        }
+
+        template<typename TFunc>
+        int count(TFunc f) {
+            std::atomic<int> ctr{ 0 };
+            run([&](std::uint64_t, TChainIterator& it) {
+                int local = 0;
+                while (it.hasNext()) {
+                    if (f(it.next())) {
+                        local++;
+                    }
+                }
+                ctr.fetch_add(local, std::memory_order_relaxed);
+            });
+            return ctr.load();
+        }
+
+        template<typename TContainer>
+        void emplaceInto(TContainer& cont) {
+            if constexpr (sized && Detail::isResizable<TContainer>) {
+                auto base = cont.size();
+                cont.resize(base + static_cast<std::size_t>(source.size()));
+                try {
+                    run([&](std::uint64_t begin, TChainIterator& it) {
+                        auto idx = base + static_cast<std::size_t>(begin);
+                        while (it.hasNext()) {
+                            cont[idx++] = it.next();
+                        }
+                    });
+                }
+                catch (...) {
+                    cont.resize(base);
+                    throw;
+                }
+                return;
+            }
+
+            Detail::ChunkResults<std::vector<TValue>> results;
+            std::mutex mutex;
+
+            run([&](std::uint64_t begin, TChainIterator& it) {
+                std::vector<TValue> local;
+                while (it.hasNext()) {
+                    local.emplace_back(it.next());
+                }
+
+                if (config.ordered) {
+                    results.add(begin, Detail::move(local));
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock{ mutex };
+                for (auto& x : local) {
+                    cont.emplace_back(Detail::move(x));
+                }
+            });
+
+            auto& chunks = results.sorted();
+            std::vector<std::size_t> offsets(chunks.size() + 1, cont.size());
+            for (std::size_t i = 0; i < chunks.size(); i++) {
+                offsets[i + 1] = offsets[i] + chunks[i].second.size();
+            }
+
+            if constexpr (Detail::isResizable<TContainer>) {
+                if (chunks.empty()) {
+                    return;
+                }
+
+                cont.resize(offsets.back());
+                auto copy = [&](std::uint64_t begin, std::uint64_t end) {
+                    for (auto i = begin; i < end; i++) {
+                        auto idx = offsets[i];
+                        for (auto& x : chunks[i].second) {
+                            cont[idx++] = Detail::move(x);
+                        }
+                        std::vector<TValue>{}.swap(chunks[i].second);
+                    }
+                };
+                Detail::Cancellation never;
+                try {
+                    Detail::runSplits(*config.executor, config.threadCount, chunks.size(), 1, 1, copy, never);
+                }
+                catch (...) {
+                    cont.resize(offsets[0]);
+                    throw;
+                }
+            }
+            else {
+                if constexpr (Detail::HasReserve<TContainer>::value) {
+                    cont.reserve(offsets.back());
+                }
+                for (auto& chunk : chunks) {
+                    for (auto& x : chunk.second) {
+                        cont.emplace_back(Detail::move(x));
+                    }
+                }
+            }
+        }
+
+        template<typename TFunc>
+        auto groupBy(TFunc keyFn) {
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+            using TGroups = std::unordered_map<TKey, std::vector<TValue>>;
+
+            auto merge = [](TGroups& into, TGroups& from) {
+                for (auto& group : from) {
+                    auto& values = into[group.first];
+                    for (auto& x : group.second) {
+                        values.emplace_back(Detail::move(x));
+                    }
+                }
+            };
+
+            Detail::ChunkResults<TGroups> results;
+            TGroups groups;
+            std::mutex mutex;
+
+            run([&](std::uint64_t begin, TChainIterator& it) {
+                TGroups local;
+                while (it.hasNext()) {
+                    auto x = it.next();
+                    local[keyFn(x)].emplace_back(Detail::move(x));
+                }
+
+                if (config.ordered) {
+                    results.add(begin, Detail::move(local));
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock{ mutex };
+                merge(groups, local);
+            });
+
+            for (auto& result : results.sorted()) {
+                merge(groups, result.second);
+            }
+            return groups;
+        }
+
+        auto distinct() {
+            auto keys = aggregate<TValue, std::uint8_t>([](const TValue& x) { return x; }, [](const TValue&) { return std::uint8_t{ 0 }; });
+            std::vector<TValue> values;
+            values.reserve(keys.size());
+            for (auto& entry : keys) {
+                values.push_back(entry.first);
+            }
+            return values;
+        }
+
+        template<typename TFunc>
+        auto countBy(TFunc keyFn) {
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+            return aggregate<TKey, std::uint64_t>(keyFn, [](const TValue&) { return std::uint64_t{ 1 }; });
+        }
+
+        template<typename TKeyFunc, typename TValueFunc>
+        auto sumBy(TKeyFunc keyFn, TValueFunc valueFn) {
+            using TKey = std::decay_t<decltype(keyFn(std::declval<TValue&>()))>;
+            using TSum = std::decay_t<decltype(valueFn(std::declval<TValue&>()))>;
+            return aggregate<TKey, TSum>(keyFn, valueFn);
+        }
+    };
+
+    namespace Detail {
+        template<typename TIt>
+        auto parallelStream(const TIt& it, std::shared_ptr<Executor> executor, int threads) {
+            if (!executor) {
+                executor = defaultExecutor();
+            }
+
+            auto source = it.source();
+            auto numThreads = threads > 0 ? threads : executor->concurrency();
+            ParallelConfig config;
+            config.executor = Detail::move(executor);
+            config.threadCount = numThreads > 0 ? numThreads : 1;
+            config.cancellation = std::make_shared<Cancellation>();
+            return ParallelStream<decltype(source), IdentityStage, decltype(source)::sized>{ source, {}, Detail::move(config) };
+        }
+
+        template<typename TIt, typename = void>
+        struct IsSplittable : std::false_type {};
+
+        template<typename TIt>
+        struct IsSplittable<TIt, std::void_t<decltype(std::declval<const TIt&>().source())>>
+            : std::bool_constant<decltype(std::declval<const TIt&>().source())::sized> {};
+
+        template<typename TIt>
+        inline constexpr bool isSplittable = IsSplittable<TIt>::value;
+
+        template<typename TSource>
+        class ChunkedShare {
+            TSource source;
+            std::uint64_t chunkSize;
+            std::atomic<std::uint64_t> cursor{ 0 };
+
+        public:
+            using TChunkIterator = decltype(std::declval<const TSource&>().iterator(0, 0));
+
+            ChunkedShare(TSource s, std::uint64_t chunk)
+                : source{ Detail::move(s) }, chunkSize{ chunk } {}
+
+            bool claim(std::optional<TChunkIterator>& chunk) {
+                auto size = source.size();
+                auto begin = cursor.fetch_add(chunkSize, std::memory_order_relaxed);
+                if (begin >= size) {
+                    return false;
+                }
+
+                chunk.emplace(source.iterator(begin, size - begin < chunkSize ? size : begin + chunkSize));
+                return true;
+            }
+        };
+
+        // Views such as the string_views from lines() point into buffers the producer reuses, so they are copied into owning values.
+        template<typename T>
+        struct Owning {
+            using type = T;
+        };
+
+        template<typename TChar, typename TTraits>
+        struct Owning<std::basic_string_view<TChar, TTraits>> {
+            using type = std::basic_string<TChar, TTraits>;
+        };
+
+        template<typename T>
+        using OwningT = typename Owning<std::remove_cv_t<std::remove_reference_t<T>>>::type;
+
+        template<typename TIt>
+        class LockedShare {
+            std::mutex mutex;
+            TIt iterator;
+            std::size_t chunkSize;
+
+        public:
+            using TValue = OwningT<decltype(std::declval<TIt&>().next())>;
+
+            LockedShare(TIt it, std::size_t chunk)
+                : iterator{ Detail::move(it) }, chunkSize{ chunk } {}
+
+            std::size_t getChunkSize() const {
+                return chunkSize;
+            }
+
+            void claim(std::vector<TValue>& buffer) {
+                buffer.clear();
+                std::lock_guard<std::mutex> lock{ mutex };
+                while (buffer.size() < chunkSize && iterator.hasNext()) {
+                    buffer.emplace_back(iterator.next());
+                }
+            }
+        };
+    }
+
+    template<typename TSource>
+    class SharedChunkIterator {
+        using TShare = Detail::ChunkedShare<TSource>;
+
+        std::shared_ptr<TShare> share;
+        std::optional<typename TShare::TChunkIterator> current;
+        bool done{ false };
+
+    public:
+        SharedChunkIterator(std::shared_ptr<TShare> s)
+            : share{ Detail::move(s) } {}
+
+        bool hasNext() {
+            while (!current || !current->hasNext()) {
+                if (done || !share->claim(current)) {
+                    done = true;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int estimateRemaining() {
+            return current ? current->estimateRemaining() : 0;
+        }
+
+        auto next() {
+            return current->next();
+        }
+    };
+
+    template<typename TIt>
+    class SharedBufferIterator {
+        using TShare = Detail::LockedShare<TIt>;
+
+        std::shared_ptr<TShare> share;
+        std::vector<typename TShare::TValue> buffer;
+        std::size_t position{ 0 };
+        bool done{ false };
+
+    public:
+        SharedBufferIterator(std::shared_ptr<TShare> s)
+            : share{ Detail::move(s) } {
+            buffer.reserve(share->getChunkSize());
+        }
+
+        bool hasNext() {
+            if (position == buffer.size() && !done) {
+                share->claim(buffer);
+                position = 0;
+                done = buffer.size() < share->getChunkSize();
+            }
+            return position < buffer.size();
+        }
+
+        int estimateRemaining() {
+            return static_cast<int>(buffer.size() - position);
+        }
+
+        typename TShare::TValue next() {
+            return Detail::move(buffer[position++]);
+        }
+    };
+
+    template<typename TConsumer, typename TShare>
+    class SharedStream {
+        std::shared_ptr<TShare> share;
+
+    public:
+        SharedStream(std::shared_ptr<TShare> s)
+            : share{ Detail::move(s) } {}
+
+        auto consumer() const {
+            return Stream<TConsumer>{ TConsumer{ share } };
+        }
+    };
+
+    template<typename TIt>
+    auto shared(Stream<TIt> stream, std::size_t chunkSize = 1024) {
+        auto chunk = chunkSize ? chunkSize : 1;
+        auto it = stream.getIterator();
+        if constexpr (Detail::isSplittable<TIt>) {
+            using TSource = decltype(it.source());
+            using TShare = Detail::ChunkedShare<TSource>;
+            return SharedStream<SharedChunkIterator<TSource>, TShare>{ std::make_shared<TShare>(it.source(), static_cast<std::uint64_t>(chunk)) };
+        }
+        else {
+            using TShare = Detail::LockedShare<TIt>;
+            return SharedStream<SharedBufferIterator<TIt>, TShare>{ std::make_shared<TShare>(Detail::move(it), chunk) };
+        }
+    }
+}
\ No newline at end of file
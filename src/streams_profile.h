@@ -0,0 +1,461 @@
+﻿#pragma once
+
+#include "streams.h"
+
+#include <chrono>
+#include <string_view>
+#include <vector>
+
+#ifdef STREAMS_HAS_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Stream {
+
+    namespace Detail {
+
+        inline std::uint64_t readTicks() {
+#if defined(_MSC_VER) && defined(_M_X64)
+            _mm_lfence();
+            return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_lfence();
+            return __builtin_ia32_rdtsc();
+#else
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        inline double ticksPerNanosecond() {
+#if defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+            static const double ratio = []() {
+                auto clockBegin = std::chrono::steady_clock::now();
+                auto tickBegin = readTicks();
+                while (std::chrono::steady_clock::now() - clockBegin < std::chrono::milliseconds{ 5 }) {}
+                auto ticks = readTicks() - tickBegin;
+                auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - clockBegin).count();
+                return nanos > 0 ? static_cast<double>(ticks) / static_cast<double>(nanos) : 1.0;
+            }();
+            return ratio;
+#else
+            return 1.0;
+#endif
+        }
+
+        inline std::uint64_t ticksToNanoseconds(std::uint64_t ticks) {
+            return static_cast<std::uint64_t>(static_cast<double>(ticks) / ticksPerNanosecond());
+        }
+    }
+
+    struct StageReport {
+        std::string_view name;
+        std::uint64_t elementsIn{ 0 };
+        std::uint64_t elementsOut{ 0 };
+        double selectivity{ 1.0 };
+        std::uint64_t nanoseconds{ 0 };
+        std::uint64_t selfNanoseconds{ 0 };
+        std::uint64_t allocations{ 0 };
+        std::uint64_t selfAllocations{ 0 };
+    };
+
+    struct HardwareCounters {
+        bool available{ false };
+        std::uint64_t cycles{ 0 };
+        std::uint64_t instructions{ 0 };
+        std::uint64_t cacheReferences{ 0 };
+        std::uint64_t cacheMisses{ 0 };
+        std::uint64_t branches{ 0 };
+        std::uint64_t branchMisses{ 0 };
+
+        double ipc() const {
+            return cycles ? static_cast<double>(instructions) / static_cast<double>(cycles) : 0.0;
+        }
+
+        HardwareCounters& operator+=(const HardwareCounters& x) {
+            available = available || x.available;
+            cycles += x.cycles;
+            instructions += x.instructions;
+            cacheReferences += x.cacheReferences;
+            cacheMisses += x.cacheMisses;
+            branches += x.branches;
+            branchMisses += x.branchMisses;
+            return *this;
+        }
+    };
+
+    struct RunReport {
+        std::uint64_t nanoseconds{ 0 };
+        std::uint64_t allocations{ 0 };
+        std::uint64_t allocatedBytes{ 0 };
+        HardwareCounters counters;
+        std::vector<HardwareCounters> threads;
+    };
+
+    struct ProfileReport {
+        std::uint64_t nanoseconds{ 0 };
+        std::uint64_t allocations{ 0 };
+        HardwareCounters counters;
+        std::vector<StageReport> stages;
+    };
+
+    namespace Detail {
+
+        class PerfCounters {
+#ifdef STREAMS_HAS_PERF_EVENTS
+            static constexpr int maxEvents = 6;
+
+            int fds[maxEvents];
+            int fields[maxEvents];
+            int numOpen{ 0 };
+
+            static int openEvent(std::uint64_t config, int groupFd) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = config;
+                attr.disabled = groupFd < 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+            }
+#endif
+
+        public:
+            PerfCounters() {
+#ifdef STREAMS_HAS_PERF_EVENTS
+                const std::uint64_t events[maxEvents] = {
+                    PERF_COUNT_HW_CPU_CYCLES,
+                    PERF_COUNT_HW_INSTRUCTIONS,
+                    PERF_COUNT_HW_CACHE_REFERENCES,
+                    PERF_COUNT_HW_CACHE_MISSES,
+                    PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+                    PERF_COUNT_HW_BRANCH_MISSES
+                };
+
+                for (int i = 0; i < maxEvents; i++) {
+                    int fd = openEvent(events[i], numOpen ? fds[0] : -1);
+                    if (fd < 0) {
+                        if (!numOpen) {
+                            return;
+                        }
+                        continue;
+                    }
+                    fds[numOpen] = fd;
+                    fields[numOpen] = i;
+                    numOpen++;
+                }
+#endif
+            }
+
+            PerfCounters(const PerfCounters&) = delete;
+            PerfCounters& operator=(const PerfCounters&) = delete;
+
+            ~PerfCounters() {
+#ifdef STREAMS_HAS_PERF_EVENTS
+                for (int i = numOpen; i-- > 0;) {
+                    ::close(fds[i]);
+                }
+#endif
+            }
+
+            bool isAvailable() const {
+#ifdef STREAMS_HAS_PERF_EVENTS
+                return numOpen > 0;
+#else
+                return false;
+#endif
+            }
+
+            void start() {
+#ifdef STREAMS_HAS_PERF_EVENTS
+                if (numOpen) {
+                    ::ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                    ::ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+                }
+#endif
+            }
+
+            void stop() {
+#ifdef STREAMS_HAS_PERF_EVENTS
+                if (numOpen) {
+                    ::ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+                }
+#endif
+            }
+
+            HardwareCounters read() const {
+                HardwareCounters counters;
+#ifdef STREAMS_HAS_PERF_EVENTS
+                std::uint64_t values[1 + maxEvents]{};
+                if (!numOpen || ::read(fds[0], values, sizeof(values)) <= 0) {
+                    return counters;
+                }
+
+                counters.available = true;
+                std::uint64_t* targets[maxEvents] = {
+                    &counters.cycles,
+                    &counters.instructions,
+                    &counters.cacheReferences,
+                    &counters.cacheMisses,
+                    &counters.branches,
+                    &counters.branchMisses
+                };
+                for (std::uint64_t i = 0; i < values[0] && i < static_cast<std::uint64_t>(numOpen); i++) {
+                    *targets[fields[i]] = values[1 + i];
+                }
+#endif
+                return counters;
+            }
+        };
+    }
+
+    template<typename TFunc>
+    auto measure(RunReport& report, TFunc terminal) {
+        Detail::PerfCounters counters;
+        auto allocations = Detail::allocationCount();
+        auto bytes = Detail::allocatedBytes();
+        auto finish = [&](std::uint64_t begin) {
+            auto end = Detail::readTicks();
+            counters.stop();
+            report.nanoseconds = Detail::ticksToNanoseconds(end - begin);
+            report.allocations = Detail::allocationCount() - allocations;
+            report.allocatedBytes = Detail::allocatedBytes() - bytes;
+            report.counters = counters.read();
+            report.threads.assign(1, report.counters);
+        };
+
+        counters.start();
+        auto begin = Detail::readTicks();
+        if constexpr (std::is_void<decltype(terminal())>::value) {
+            terminal();
+            finish(begin);
+        }
+        else {
+            auto result = terminal();
+            finish(begin);
+            return result;
+        }
+    }
+
+    namespace Detail {
+
+        inline std::uint64_t tickOverhead() {
+            static const std::uint64_t overhead = []() {
+                std::uint64_t best = ~std::uint64_t{ 0 };
+                for (int i = 0; i < 64; i++) {
+                    auto begin = readTicks();
+                    auto ticks = readTicks() - begin;
+                    best = ticks < best ? ticks : best;
+                }
+                return best;
+            }();
+            return overhead;
+        }
+
+        inline bool& isSamplingStage() {
+            static thread_local bool active = false;
+            return active;
+        }
+
+        // Nested stages defer their samples while an outer stage is being timed
+        struct CallSampler {
+            std::uint64_t calls{ 0 };
+            std::uint64_t samples{ 0 };
+            std::uint64_t sampledTicks{ 0 };
+            bool pending{ false };
+
+            bool shouldSample() {
+                if (++calls % STREAMS_PROFILE_SAMPLE_INTERVAL == 0) {
+                    pending = true;
+                }
+                return pending && !isSamplingStage();
+            }
+
+            std::uint64_t begin() {
+                isSamplingStage() = true;
+                return readTicks();
+            }
+
+            void record(std::uint64_t beginTicks) {
+                auto ticks = readTicks() - beginTicks;
+                isSamplingStage() = false;
+                pending = false;
+                sampledTicks += ticks > tickOverhead() ? ticks - tickOverhead() : 0;
+                samples++;
+            }
+
+            std::uint64_t estimatedTicks() const {
+                return samples ? static_cast<std::uint64_t>(static_cast<double>(sampledTicks) * calls / samples) : 0;
+            }
+        };
+
+        struct StageStats {
+            std::string_view name;
+            std::shared_ptr<StageStats> upstream;
+            std::uint64_t elements{ 0 };
+            std::uint64_t allocations{ 0 };
+            CallSampler hasNextCalls;
+            CallSampler nextCalls;
+
+            StageStats(std::string_view n, std::shared_ptr<StageStats> u)
+                : name{ n }, upstream{ Detail::move(u) } {}
+
+            std::uint64_t estimatedTicks() const {
+                return hasNextCalls.estimatedTicks() + nextCalls.estimatedTicks();
+            }
+        };
+    }
+
+    template<typename TIt>
+    class ProfileIterator {
+        TIt it;
+        std::shared_ptr<Detail::StageStats> stats;
+
+    public:
+        static constexpr std::size_t extent = Detail::extentOf<TIt>;
+
+    private:
+        bool sampledHasNext() {
+            if (!stats->hasNextCalls.shouldSample()) {
+                return it.hasNext();
+            }
+
+            auto begin = stats->hasNextCalls.begin();
+            bool result = it.hasNext();
+            stats->hasNextCalls.record(begin);
+            return result;
+        }
+
+        auto sampledNext() {
+            if (!stats->nextCalls.shouldSample()) {
+                return it.next();
+            }
+
+            auto begin = stats->nextCalls.begin();
+            auto x = it.next();
+            stats->nextCalls.record(begin);
+            return x;
+        }
+
+    public:
+        ProfileIterator(TIt i, std::shared_ptr<Detail::StageStats> s)
+            : it{ Detail::move(i) }, stats{ Detail::move(s) } {}
+
+        bool hasNext() {
+#ifdef STREAMS_COUNT_ALLOCATIONS
+            auto allocations = Detail::allocationCount();
+            bool result = sampledHasNext();
+            stats->allocations += Detail::allocationCount() - allocations;
+            return result;
+#else
+            return sampledHasNext();
+#endif
+        }
+
+        int estimateRemaining() {
+            return it.estimateRemaining();
+        }
+
+        auto next() {
+            stats->elements++;
+#ifdef STREAMS_COUNT_ALLOCATIONS
+            auto allocations = Detail::allocationCount();
+            auto x = sampledNext();
+            stats->allocations += Detail::allocationCount() - allocations;
+            return x;
+#else
+            return sampledNext();
+#endif
+        }
+
+        template<typename T = TIt>
+        auto source() const -> decltype(std::declval<const T&>().source()) {
+            return it.source();
+        }
+
+        template<typename T = TIt>
+        auto at(std::size_t idx) const -> decltype(std::declval<const T&>().at(idx)) {
+            return it.at(idx);
+        }
+
+        template<typename T = TIt>
+        auto size() const -> decltype(std::declval<const T&>().size()) {
+            return it.size();
+        }
+
+        const std::shared_ptr<Detail::StageStats>& getStats() const {
+            return stats;
+        }
+    };
+
+    namespace Detail {
+
+        template<typename TIt>
+        auto profileSource(const TIt& it) {
+            return ProfileIterator<TIt>{ it, std::make_shared<StageStats>(typeName<TIt>(), nullptr) };
+        }
+
+        template<typename TIt>
+        auto profileSource(const ProfileIterator<TIt>& it) {
+            return it;
+        }
+
+        template<typename TIt, typename TUpstream>
+        auto profileStage(const TIt& it, const TUpstream& upstream) {
+            auto stats = std::make_shared<StageStats>(typeName<TIt>(), upstream.getStats());
+            return Stream<ProfileIterator<TIt>>{ ProfileIterator<TIt>{ it, Detail::move(stats) } };
+        }
+
+        template<typename TIt>
+        void collectProfile(const TIt&, ProfileReport&) {}
+
+        template<typename TIt>
+        void collectProfile(const ProfileIterator<TIt>& it, ProfileReport& report) {
+            std::vector<const StageStats*> chain;
+            for (auto stats = it.getStats().get(); stats; stats = stats->upstream.get()) {
+                chain.push_back(stats);
+            }
+
+            for (auto idx = chain.size(); idx-- > 0;) {
+                auto stats = chain[idx];
+                auto upstream = stats->upstream.get();
+
+                StageReport stage;
+                stage.name = stats->name;
+                stage.elementsOut = stats->elements;
+                stage.elementsIn = upstream ? upstream->elements : stats->elements;
+                stage.selectivity = stage.elementsIn ? static_cast<double>(stage.elementsOut) / static_cast<double>(stage.elementsIn) : 1.0;
+                stage.nanoseconds = ticksToNanoseconds(stats->estimatedTicks());
+
+                auto upstreamNanos = upstream ? ticksToNanoseconds(upstream->estimatedTicks()) : 0;
+                stage.selfNanoseconds = stage.nanoseconds > upstreamNanos ? stage.nanoseconds - upstreamNanos : 0;
+                stage.allocations = stats->allocations;
+                stage.selfAllocations = stats->allocations - (upstream ? upstream->allocations : 0);
+                report.stages.push_back(stage);
+            }
+        }
+
+        template<typename TIt, typename TSink>
+        auto profileRun(const TIt& it, TSink sink) {
+            PerfCounters counters;
+            auto allocations = allocationCount();
+            counters.start();
+            auto begin = readTicks();
+            sink();
+            auto end = readTicks();
+            counters.stop();
+
+            ProfileReport report;
+            report.nanoseconds = ticksToNanoseconds(end - begin);
+            report.allocations = allocationCount() - allocations;
+            report.counters = counters.read();
+            collectProfile(it, report);
+            return report;
+        }
+    }
+}
\ No newline at end of file
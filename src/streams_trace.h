@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include "streams_parallel.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace Stream {
+
+    inline void startTrace() {
+#ifdef STREAMS_ENABLE_TRACING
+        auto& registry = Detail::TraceRegistry::get();
+        registry.active.store(false);
+        Detail::ticksPerNanosecond();
+        registry.reset();
+        registry.active.store(true);
+#endif
+    }
+
+    inline void stopTrace() {
+#ifdef STREAMS_ENABLE_TRACING
+        Detail::TraceRegistry::get().active.store(false);
+#endif
+    }
+
+    inline std::string traceJson() {
+        std::string json{ "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" };
+#ifdef STREAMS_ENABLE_TRACING
+        auto& registry = Detail::TraceRegistry::get();
+        bool first = true;
+        char line[256];
+        auto append = [&](int length) {
+            json.append(first ? "\n" : ",\n");
+            json.append(line, static_cast<std::size_t>(length));
+            first = false;
+        };
+
+        registry.forEachBuffer([&](const Detail::TraceBuffer& buffer) {
+            if (buffer.events.empty()) {
+                return;
+            }
+
+            append(std::snprintf(line, sizeof(line),
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"streams-%u\"}}",
+                buffer.threadId, buffer.threadId));
+            for (auto& event : buffer.events) {
+                auto ticks = event.ticks > registry.epoch ? event.ticks - registry.epoch : 0;
+                auto nanoseconds = static_cast<unsigned long long>(Detail::ticksToNanoseconds(ticks));
+                append(std::snprintf(line, sizeof(line),
+                    "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%u%s,\"args\":{\"value\":%llu}}",
+                    event.name, event.phase, nanoseconds / 1000, nanoseconds % 1000, buffer.threadId,
+                    event.phase == 'i' ? ",\"s\":\"t\"" : "", static_cast<unsigned long long>(event.arg)));
+            }
+        });
+#endif
+        json.append("\n]}\n");
+        return json;
+    }
+
+    inline void writeTrace(const std::filesystem::path& path) {
+        auto json = traceJson();
+        std::FILE* file = std::fopen(path.string().c_str(), "wb");
+        if (!file) {
+            throw Detail::IOException{ errno };
+        }
+
+        bool failed = std::fwrite(json.data(), 1, json.size(), file) != json.size();
+        failed = std::fclose(file) != 0 || failed;
+        if (failed) {
+            throw Detail::IOException{ EIO };
+        }
+    }
+}
\ No newline at end of file
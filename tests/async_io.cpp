@@ -0,0 +1,64 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+    std::string readAll(const std::filesystem::path& path) {
+        std::ifstream in{ path, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ in }, std::istreambuf_iterator<char>{} };
+    }
+}
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "streams_async_io.txt";
+    std::vector<std::string> expected;
+    std::string content;
+    for (int i = 0; i < 20000; i++) {
+        expected.push_back(std::to_string(i) + std::string(static_cast<std::size_t>(i % 70), 'a' + i % 26));
+        content += expected.back() + "\n";
+    }
+
+    Stream::WriteOptions writeOptions;
+    writeOptions.asyncIo = true;
+    writeOptions.bufferSize = 4096;
+    writeOptions.bufferCount = 4;
+    {
+        Stream::BufferedWriter writer{ path, writeOptions };
+        writer.append(content);
+        CHECK(writer.close() == content.size());
+    }
+    CHECK(readAll(path) == content);
+
+    {
+        Stream::BufferedWriter writer{ path, writeOptions };
+        writer.append(content);
+    }
+    CHECK(readAll(path) == content);
+
+    Stream::ReadOptions readOptions;
+    readOptions.asyncIo = true;
+    readOptions.blockSize = 4096;
+    readOptions.queueDepth = 4;
+    std::vector<std::string> lines;
+    Stream::lines(path, readOptions).forEach([&](std::string_view line) { lines.emplace_back(line); });
+    CHECK(lines == expected);
+
+    std::string blocks;
+    Stream::Detail::FileReader reader{ path, readOptions };
+    while (reader.hasNext()) {
+        blocks += reader.next();
+    }
+    CHECK(blocks == content);
+
+    {
+        Stream::Detail::FileReader abandoned{ path, readOptions };
+        CHECK(abandoned.next().size() == 4096);
+    }
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
@@ -0,0 +1,136 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+
+namespace {
+    std::string readAll(const std::filesystem::path& path) {
+        std::ifstream in{ path, std::ios::binary };
+        return { std::istreambuf_iterator<char>{ in }, std::istreambuf_iterator<char>{} };
+    }
+
+    std::size_t openFds() {
+        std::size_t count = 0;
+        for (auto& entry : std::filesystem::directory_iterator{ "/proc/self/fd" }) {
+            (void)entry;
+            count++;
+        }
+        return count;
+    }
+
+    // Writes to a non-blocking pipe whose reader starts late, so the first writev only fills the pipe buffer.
+    std::string writePipe(const std::string& content, Stream::PartialWritePolicy policy, int& error) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            return {};
+        }
+        ::fcntl(fds[1], F_SETFL, ::fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+        std::string received;
+        std::thread reader{ [&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+            char buffer[4096];
+            while (true) {
+                auto num = ::read(fds[0], buffer, sizeof(buffer));
+                if (num <= 0) {
+                    break;
+                }
+                received.append(buffer, static_cast<std::size_t>(num));
+            }
+        } };
+
+        Stream::WriteOptions options;
+        options.bufferSize = content.size();
+        options.partialWrites = policy;
+        error = 0;
+        try {
+            Stream::BufferedWriter writer{ fds[1], options };
+            writer.append(content);
+            writer.close();
+        }
+        catch (const Stream::Detail::IOException& e) {
+            error = e.error;
+        }
+
+        ::close(fds[1]);
+        reader.join();
+        ::close(fds[0]);
+        return received;
+    }
+}
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "streams_buffered_writer.txt";
+    std::vector<int> values(50000);
+    std::string expected;
+    for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<int>(i * 7919 % 100003) - 50000;
+        expected += std::to_string(values[i]) + "\n";
+    }
+    auto format = [](int x, Stream::BufferedWriter& writer) {
+        writer.appendNumber(x);
+        writer.append('\n');
+    };
+
+    for (bool background : { false, true }) {
+        for (std::size_t bufferSize : { std::size_t{ 4096 }, std::size_t{ 1 << 20 } }) {
+            Stream::WriteOptions options;
+            options.background = background;
+            options.bufferSize = bufferSize;
+            options.bufferCount = 3;
+            CHECK(Stream::of(values).writeTo(path, format, options) == expected.size());
+            CHECK(readAll(path) == expected);
+
+            {
+                Stream::BufferedWriter writer{ path, options };
+                writer.append(expected);
+            }
+            CHECK(readAll(path) == expected);
+
+            Stream::WriteOptions full = options;
+            full.fsync = Stream::FsyncPolicy::OnClose;
+            int error = 0;
+            try {
+                Stream::of(values).writeTo("/dev/full", format, full);
+            }
+            catch (const Stream::Detail::IOException& e) {
+                error = e.error;
+            }
+            CHECK(error == ENOSPC);
+
+            Stream::BufferedWriter writer{ "/dev/full", options };
+            writer.append("x");
+            CHECK_THROWS(writer.close(), Stream::Detail::IOException);
+            CHECK(writer.close() == 0);
+        }
+    }
+
+    CHECK_THROWS(Stream::BufferedWriter(std::filesystem::path{ "/nonexistent/streams.txt" }), Stream::Detail::IOException);
+
+#if !defined(__SANITIZE_ADDRESS__)
+    auto before = openFds();
+    Stream::WriteOptions huge;
+    huge.bufferSize = std::size_t{ 1 } << 62;
+    CHECK_THROWS(Stream::BufferedWriter(path, huge), std::bad_alloc);
+    CHECK(openFds() == before);
+#endif
+
+    std::string content(256 * 1024, 'p');
+    int error = 0;
+    CHECK(writePipe(content, Stream::PartialWritePolicy::Retry, error) == content);
+    CHECK(error == 0);
+    auto partial = writePipe(content, Stream::PartialWritePolicy::Fail, error);
+    CHECK(error == EIO);
+    CHECK(partial.size() < content.size());
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
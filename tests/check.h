@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+
+namespace Check {
+    inline int failures = 0;
+
+    inline int result() {
+        if (failures) {
+            std::fprintf(stderr, "%d check%s failed\n", failures, failures == 1 ? "" : "s");
+        }
+        return failures ? 1 : 0;
+    }
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            Check::failures++; \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression, exception) \
+    do { \
+        bool thrown = false; \
+        try { \
+            (void)(expression); \
+        } \
+        catch (const exception&) { \
+            thrown = true; \
+        } \
+        if (!thrown) { \
+            std::fprintf(stderr, "%s:%d: CHECK_THROWS(%s) did not throw\n", __FILE__, __LINE__, #expression); \
+            Check::failures++; \
+        } \
+    } while (0)
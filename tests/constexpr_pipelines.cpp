@@ -0,0 +1,76 @@
+#include "streams.h"
+#include "check.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace {
+    constexpr std::uint32_t crcStep(std::uint32_t crc) {
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        return crc;
+    }
+
+    constexpr auto crcTable = [] {
+        std::array<std::uint32_t, 256> table{};
+        std::size_t idx = 0;
+        Stream::iota(0u, 256u).map(crcStep).forEach([&](std::uint32_t x) { table[idx++] = x; });
+        return table;
+    }();
+
+    static_assert(crcTable[0] == 0);
+    static_assert(crcTable[1] == 0x77073096u);
+    static_assert(crcTable[255] == 0x2D02EF8Du);
+
+    constexpr int data[] = { 5, 3, 8, 1, 9, 2 };
+
+    constexpr int sumOfEvensTimesTen() {
+        return Stream::of(data).filter([](int x) { return x % 2 == 0; }).map([](int x) { return x * 10; }).reduce([](int x, int accu) { return accu + x; }, 0);
+    }
+
+    static_assert(sumOfEvensTimesTen() == 100);
+
+    constexpr int flattened() {
+        std::array<int, 3> sizes{ 1, 2, 3 };
+        return Stream::of(sizes).flatMap([](int x) { return Stream::iota(0, x); }).tap([](int) {}).limit(5).count();
+    }
+
+    static_assert(flattened() == 5);
+
+    constexpr bool collectsIntoVector() {
+        std::vector<int> values;
+        Stream::of(data).map([](int x) { return x + 1; }).emplaceInto(values);
+        return values.size() == 6 && values[2] == 9 && Stream::of(values).anyMatch([](int x) { return x == 10; }) && Stream::of(values).allMatch([](int x) { return x > 1; });
+    }
+
+    static_assert(collectsIntoVector());
+
+    constexpr auto squares = Stream::of(data).map([](int x) { return x * x; }).toArray();
+    static_assert(squares.size() == 6);
+    static_assert(squares[0] == 25 && squares[2] == 64 && squares[5] == 4);
+
+    constexpr auto bounds = [] {
+        std::array<int, 4> limits{ 1, 2, 3, 4 };
+        return Stream::of(limits).map([](int x) { return x * 100; }).toArray();
+    }();
+    static_assert(bounds == std::array<int, 4>{ 100, 200, 300, 400 });
+}
+
+int main() {
+    std::uint32_t runtimeTable[256];
+    std::size_t idx = 0;
+    Stream::iota(0u, 256u).map(crcStep).forEach([&](std::uint32_t x) { runtimeTable[idx++] = x; });
+    for (std::size_t i = 0; i < 256; i++) {
+        CHECK(runtimeTable[i] == crcTable[i]);
+    }
+    CHECK(sumOfEvensTimesTen() == 100);
+    CHECK(collectsIntoVector());
+
+    int values[3] = { 1, 2, 3 };
+    auto doubled = Stream::of(values).map([](int x) { return x * 2; }).toArray();
+    CHECK((doubled == std::array<int, 3>{ 2, 4, 6 }));
+
+    return Check::result();
+}
@@ -0,0 +1,55 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+    std::vector<std::string> readFifo(const std::filesystem::path& path, const std::string& content, std::size_t blockSize) {
+        std::thread writer{ [&] {
+            int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+            std::size_t written = 0;
+            while (written < content.size()) {
+                auto chunk = content.size() - written < 1000 ? content.size() - written : 1000;
+                written += static_cast<std::size_t>(::write(fd, content.data() + written, chunk));
+            }
+            ::close(fd);
+        } };
+
+        Stream::ReadOptions options;
+        options.blockSize = blockSize;
+        std::vector<std::string> result;
+        Stream::lines(path, options).forEach([&](std::string_view line) { result.emplace_back(line); });
+        writer.join();
+        return result;
+    }
+}
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "streams_file_reader.fifo";
+    std::filesystem::remove(path);
+    if (::mkfifo(path.c_str(), 0600) != 0) {
+        return 1;
+    }
+
+    std::string content;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 2000; i++) {
+        expected.push_back(std::to_string(i) + std::string(static_cast<std::size_t>(i % 50), 'x'));
+        content += expected.back() + "\n";
+    }
+    CHECK(readFifo(path, content, 4096) == expected);
+    CHECK(readFifo(path, content, 1 << 20) == expected);
+
+    std::string exact(4096, 'y');
+    exact.back() = '\n';
+    CHECK(readFifo(path, exact, 4096) == std::vector<std::string>{ exact.substr(0, 4095) });
+    CHECK(readFifo(path, "", 4096).empty());
+    CHECK((readFifo(path, "a\nb", 4096) == std::vector<std::string>{ "a", "b" }));
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
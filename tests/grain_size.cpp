@@ -0,0 +1,61 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    void spin(std::chrono::microseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < until) {}
+    }
+
+    struct Workers {
+        std::mutex mutex;
+        std::set<std::thread::id> ids;
+
+        void record() {
+            std::lock_guard<std::mutex> lock{ mutex };
+            ids.insert(std::this_thread::get_id());
+        }
+    };
+}
+
+int main() {
+    Stream::ThreadPool pool{ { 4, {}, {} } };
+
+    std::vector<int> data(16);
+    Workers ranges;
+    auto count = Stream::of(data.data(), data.data() + data.size()).parallel(pool).map([&](int x) {
+        spin(std::chrono::milliseconds{ 5 });
+        ranges.record();
+        return x;
+    }).count();
+    CHECK(count == 16);
+    CHECK(ranges.ids.size() > 1);
+
+    auto path = std::filesystem::temp_directory_path() / "streams_grain_size.txt";
+    {
+        std::ofstream out{ path, std::ios::binary };
+        for (int i = 0; i < 4000; i++) {
+            out << std::string(250, 'a' + i % 26) << '\n';
+        }
+    }
+
+    Workers lines;
+    auto numLines = Stream::lines(path).parallel(pool).map([&](std::string_view line) {
+        spin(std::chrono::microseconds{ 50 });
+        lines.record();
+        return line.size();
+    }).count();
+    CHECK(numLines == 4000);
+    CHECK(lines.ids.size() > 1);
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
@@ -0,0 +1,31 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+static_assert(std::is_same_v<decltype(Stream::jsonLines("records.ndjson")), decltype(Stream::jsonLines(std::filesystem::path{}))>);
+static_assert(std::is_same_v<decltype(Stream::jsonLines(std::string{})), decltype(Stream::jsonLines(std::filesystem::path{}))>);
+
+int main() {
+    auto latency = [](Stream::JsonRecord r) { return r.get<double>("latency"); };
+    auto add = [](double x, double accu) { return accu + x; };
+
+    CHECK(Stream::jsonLinesBuffer("{\"latency\": 1.5}\n{\"latency\": 2}").map(latency).reduce(add, 0.0) == 3.5);
+
+    std::string buffer = "{\"id\": 1, \"latency\": 0.5}\n\n{\"id\": 2, \"latency\": 4}\n";
+    CHECK(Stream::jsonLinesBuffer(buffer).map(latency).reduce(add, 0.0) == 4.5);
+
+    auto path = std::filesystem::temp_directory_path() / "streams_json_lines.ndjson";
+    {
+        std::ofstream out{ path, std::ios::binary };
+        out << buffer;
+    }
+    CHECK(Stream::jsonLines(path).map(latency).reduce(add, 0.0) == 4.5);
+    CHECK(Stream::jsonLines(path.string()).map(latency).reduce(add, 0.0) == 4.5);
+    CHECK(Stream::jsonLines(path.c_str()).map(latency).reduce(add, 0.0) == 4.5);
+    std::filesystem::remove(path);
+
+    return Check::result();
+}
@@ -0,0 +1,62 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    // Records start with "##" at the beginning of a line and may span several lines.
+    struct EntryResync {
+        std::size_t operator()(std::string_view window) const {
+            auto pos = window.find("\n##");
+            return pos == std::string_view::npos ? pos : pos + 1;
+        }
+    };
+
+    template<typename TStream>
+    std::vector<std::string> collect(TStream stream) {
+        std::vector<std::string> result;
+        stream.forEach([&](std::string_view record) { result.emplace_back(record); });
+        return result;
+    }
+}
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "streams_lines.txt";
+    std::vector<std::string> lines;
+    std::vector<std::string> entries;
+    {
+        std::ofstream out{ path, std::ios::binary };
+        for (int i = 0; i < 3000; i++) {
+            auto entry = "##" + std::to_string(i);
+            lines.push_back(entry);
+            for (int j = 0; j < i % 4; j++) {
+                lines.push_back(std::string(static_cast<std::size_t>(i % 90), 'x') + std::to_string(j));
+                entry += "\n" + lines.back();
+            }
+            entries.push_back(entry);
+            out << entry << '\n';
+        }
+    }
+
+    for (std::size_t blockSize : { 7, 64, 1 << 20 }) {
+        Stream::ReadOptions options;
+        options.blockSize = blockSize;
+        CHECK(collect(Stream::lines(path, options)) == lines);
+        CHECK(collect(Stream::lines(path, EntryResync{}, options)) == entries);
+    }
+
+    Stream::ThreadPool pool{ { 3, {}, {} } };
+    Stream::ReadOptions options;
+    options.blockSize = 256;
+    std::vector<std::string> parallel;
+    Stream::lines(path, EntryResync{}, options).parallel(pool).map([](std::string_view record) { return std::string{ record }; }).emplaceInto(parallel);
+    std::sort(parallel.begin(), parallel.end());
+    std::sort(entries.begin(), entries.end());
+    CHECK(parallel == entries);
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
@@ -0,0 +1,41 @@
+#include "streams.h"
+#include "check.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+int main() {
+    std::vector<int> ints(1000);
+    for (std::size_t i = 0; i < ints.size(); i++) {
+        ints[i] = static_cast<int>(i);
+    }
+    int pair[2] = { 1, 2 };
+    auto add = [](long x, long accu) { return accu + x; };
+    auto odd = [](long x) { return x % 2 != 0; };
+
+    CHECK(Stream::of(ints).assertNoAlloc().count() == 1000);
+    CHECK(Stream::of(ints).map([](int x) { return x * 2L; }).filter(odd).assertNoAlloc().reduce(add, 0L) == 0);
+    CHECK(Stream::of(ints).filter([](int x) { return x % 2 != 0; }).tap([](int) {}).limit(10).assertNoAlloc().reduce(add, 0L) == 100);
+    CHECK(Stream::of(ints).flatMap([&](int) { return Stream::of(pair); }).assertNoAlloc().reduce(add, 0L) == 3000);
+    CHECK(Stream::of(ints).zip(Stream::of(ints), [](int a, int b) { return a - b; }).reverse().assertNoAlloc().reduce(add, 0L) == 0);
+    CHECK(Stream::of(ints).assertNoAlloc().findFirst([](int x) { return x == 500; }) == 500);
+
+    std::vector<std::string_view> numbers{ "1", "22", "x", "333" };
+    CHECK(Stream::of(numbers).parseInts<int>().assertNoAlloc().reduce(add, 0L) == 356);
+
+    std::vector<std::string> longStrings(10, std::string(64, 'a'));
+    const std::vector<std::string> constLongStrings(10, std::string(64, 'a'));
+    auto nonEmpty = [](const std::string& x) { return !x.empty(); };
+
+    // FilterIterator moves the matching element into its buffer, but a const container makes the source copy every string.
+    CHECK(Stream::of(longStrings).filter(nonEmpty).assertNoAlloc().count() == 10);
+    CHECK_THROWS(Stream::of(constLongStrings).filter(nonEmpty).assertNoAlloc().count(), Stream::Detail::AllocationError);
+    CHECK_THROWS(Stream::of(ints).map([](int x) { return std::to_string(x) + std::string(64, 'b'); }).assertNoAlloc().count(), Stream::Detail::AllocationError);
+
+    std::vector<std::string> seen;
+    seen.reserve(1);
+    CHECK_THROWS(Stream::of(ints).assertNoAlloc().forEach([&](int x) { seen.push_back(std::to_string(x) + std::string(64, 'c')); }), Stream::Detail::AllocationError);
+
+    return Check::result();
+}
@@ -0,0 +1,17 @@
+#include "streams.h"
+#include "check.h"
+
+int main() {
+    int data[3] = { 1, 2, 3 };
+
+    // STREAMS_COUNT_ALLOCATIONS is defined but no operator new hook updates the counters.
+    try {
+        Stream::of(data).assertNoAlloc().count();
+        CHECK(false);
+    }
+    catch (const Stream::Detail::AllocationError& e) {
+        CHECK(e.allocations == 0);
+    }
+
+    return Check::result();
+}
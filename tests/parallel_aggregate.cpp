@@ -0,0 +1,65 @@
+#include "streams_parallel.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    template<typename TKey, typename TValue>
+    std::map<TKey, TValue> sorted(const std::unordered_map<TKey, TValue>& map) {
+        return { map.begin(), map.end() };
+    }
+
+    // Runs distinct(), countBy() and sumBy() over data and compares them with sequential loops.
+    void checkAggregates(Stream::ThreadPool& pool, const std::vector<int>& data, int numKeys) {
+        auto begin = data.data();
+        auto end = data.data() + data.size();
+        auto key = [numKeys](int x) { return x % numKeys; };
+        auto weight = [](int x) { return static_cast<double>(x % 7); };
+
+        std::map<int, std::uint64_t> counts;
+        std::map<int, double> sums;
+        for (int x : data) {
+            counts[key(x)]++;
+            sums[key(x)] += weight(x);
+        }
+        std::vector<int> keys;
+        for (auto& entry : counts) {
+            keys.push_back(entry.first);
+        }
+
+        auto distinct = Stream::of(begin, end).parallel(pool).map(key).distinct();
+        std::sort(distinct.begin(), distinct.end());
+        CHECK(distinct == keys);
+        CHECK(sorted(Stream::of(begin, end).parallel(pool).countBy(key)) == counts);
+        CHECK(sorted(Stream::of(begin, end).parallel(pool).sumBy(key, weight)) == sums);
+
+        std::map<int, std::uint64_t> evenCounts;
+        for (int x : data) {
+            if (x % 2 == 0) {
+                evenCounts[key(x)]++;
+            }
+        }
+        CHECK(sorted(Stream::of(begin, end).parallel(pool).filter([](int x) { return x % 2 == 0; }).countBy(key)) == evenCounts);
+    }
+}
+
+int main() {
+    std::vector<int> data(300000);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<int>(i * 2654435761u % 1000003);
+    }
+
+    for (int threads : { 1, 2, 4 }) {
+        Stream::ThreadPool pool{ { threads, {}, {} } };
+        // Few keys keep every worker on its local table
+        checkAggregates(pool, data, 97);
+        // Mostly unique keys switch the run to the shared concurrent table after the first large chunk
+        checkAggregates(pool, data, 200000);
+    }
+
+    return Check::result();
+}
@@ -0,0 +1,101 @@
+#include "streams_parallel.h"
+#include "check.h"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // Move assignment throws for one value, which fails the copy phase of a two-phase emplaceInto().
+    struct Fragile {
+        int value{ 0 };
+
+        Fragile() = default;
+
+        Fragile(int v)
+            : value{ v } {}
+
+        Fragile(Fragile&&) = default;
+        Fragile(const Fragile&) = default;
+        Fragile& operator=(const Fragile&) = default;
+
+        Fragile& operator=(Fragile&& other) {
+            if (other.value == 4321) {
+                throw std::runtime_error{ "move" };
+            }
+            value = other.value;
+            return *this;
+        }
+    };
+}
+
+int main() {
+    std::vector<int> data(20000);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<int>(i);
+    }
+    auto begin = data.data();
+    auto end = data.data() + data.size();
+    auto toString = [](int x) { return std::to_string(x); };
+    auto odd = [](int x) { return x % 2 != 0; };
+
+    std::vector<std::string> mapped{ "head" };
+    std::vector<std::string> filtered{ "head" };
+    for (int x : data) {
+        mapped.push_back(toString(x));
+        if (odd(x)) {
+            filtered.push_back(toString(x));
+        }
+    }
+
+    for (int threads : { 1, 2, 4 }) {
+        Stream::ThreadPool pool{ { threads, {}, {} } };
+
+        std::vector<std::string> presized{ "head" };
+        Stream::of(begin, end).parallel(pool).map(toString).emplaceInto(presized);
+        CHECK(presized == mapped);
+
+        std::vector<std::string> twoPhase{ "head" };
+        Stream::of(begin, end).parallel(pool).filter(odd).map(toString).emplaceInto(twoPhase);
+        CHECK(twoPhase == filtered);
+
+        std::deque<std::string> deque{ "head" };
+        Stream::of(begin, end).parallel(pool).filter(odd).map(toString).emplaceInto(deque);
+        CHECK(std::vector<std::string>(deque.begin(), deque.end()) == filtered);
+
+        std::list<std::string> list{ "head" };
+        Stream::of(begin, end).parallel(pool).filter(odd).map(toString).emplaceInto(list);
+        CHECK(std::vector<std::string>(list.begin(), list.end()) == filtered);
+
+        std::vector<std::string> unordered{ "head" };
+        Stream::of(begin, end).parallel(pool).filter(odd).map(toString).unordered().emplaceInto(unordered);
+        std::sort(unordered.begin(), unordered.end());
+        auto sortedFiltered = filtered;
+        std::sort(sortedFiltered.begin(), sortedFiltered.end());
+        CHECK(unordered == sortedFiltered);
+
+        auto failAt = [&](int x) {
+            if (x == 12345) {
+                throw std::runtime_error{ "map" };
+            }
+            return toString(x);
+        };
+        std::vector<std::string> rolledBack{ "head" };
+        CHECK_THROWS(Stream::of(begin, end).parallel(pool).map(failAt).emplaceInto(rolledBack), std::runtime_error);
+        CHECK(rolledBack == std::vector<std::string>{ "head" });
+        CHECK_THROWS(Stream::of(begin, end).parallel(pool).filter(odd).map(failAt).emplaceInto(rolledBack), std::runtime_error);
+        CHECK(rolledBack == std::vector<std::string>{ "head" });
+
+        auto toFragile = [](int x) { return Fragile{ x }; };
+        std::vector<Fragile> fragile(1, Fragile{ -1 });
+        CHECK_THROWS(Stream::of(begin, end).parallel(pool).map(toFragile).emplaceInto(fragile), std::runtime_error);
+        CHECK(fragile.size() == 1 && fragile[0].value == -1);
+        CHECK_THROWS(Stream::of(begin, end).parallel(pool).filter(odd).map(toFragile).emplaceInto(fragile), std::runtime_error);
+        CHECK(fragile.size() == 1 && fragile[0].value == -1);
+    }
+
+    return Check::result();
+}
@@ -0,0 +1,52 @@
+#include "streams_parallel.h"
+#include "check.h"
+
+#include <atomic>
+#include <vector>
+
+int main() {
+    std::vector<int> data(100000);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<int>(i);
+    }
+    auto begin = data.data();
+    auto end = data.data() + data.size();
+    auto even = [](int x) { return x % 2 == 0; };
+
+    for (int threads : { 1, 2, 4 }) {
+        Stream::ThreadPool pool{ { threads, {}, {} } };
+
+        auto limited = Stream::of(begin, end).parallel(pool).filter(even).limit(10);
+        CHECK(limited.count() == 10);
+        CHECK(limited.count() == 10);
+        std::vector<int> taken;
+        limited.emplaceInto(taken);
+        CHECK(taken.size() == 10);
+        CHECK(Stream::of(taken).allMatch(even));
+
+        auto sizedLimit = Stream::of(begin, end).parallel(pool).map([](int x) { return x * 2; }).limit(5);
+        std::vector<int> firstFive;
+        sizedLimit.emplaceInto(firstFive);
+        CHECK((firstFive == std::vector<int>{ 0, 2, 4, 6, 8 }));
+        CHECK(sizedLimit.count() == 5);
+
+        for (int target : { 0, 999, 50000, 99999 }) {
+            auto found = Stream::of(begin, end).parallel(pool).findFirst([&](int x) { return x >= target && x % 1000 == target % 1000; });
+            CHECK(found && *found == target);
+        }
+        CHECK(!Stream::of(begin, end).parallel(pool).findFirst([](int x) { return x < 0; }));
+
+        std::atomic<int> calls{ 0 };
+        CHECK(Stream::of(begin, end).parallel(pool).anyMatch([&](int x) { calls++; return x < 10; }));
+        CHECK(calls.load() < static_cast<int>(data.size()) / 2);
+
+        calls = 0;
+        CHECK(!Stream::of(begin, end).parallel(pool).allMatch([&](int x) { calls++; return x > 10; }));
+        CHECK(calls.load() < static_cast<int>(data.size()) / 2);
+
+        CHECK(Stream::of(begin, end).parallel(pool).allMatch([](int x) { return x >= 0; }));
+        CHECK(!Stream::of(begin, end).parallel(pool).anyMatch([](int x) { return x < 0; }));
+    }
+
+    return Check::result();
+}
@@ -0,0 +1,52 @@
+#include "streams_parallel.h"
+#include "check.h"
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+int main() {
+    std::vector<int> data(10007);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<int>(i % 13);
+    }
+    auto begin = data.data();
+    auto end = data.data() + data.size();
+    auto add = [](int x, long accu) { return accu + x; };
+    auto expected = Stream::of(begin, end).reduce(add, 10L);
+
+    for (int threads : { 1, 2, 3, 4 }) {
+        Stream::ThreadPool pool{ { threads, {}, {} } };
+        CHECK(Stream::of(begin, end).parallel(pool).reduce(add, 10L, std::plus<long>{}, 0L) == expected);
+        CHECK(Stream::of(begin, end).parallel(pool).deterministic(100).reduce(add, 10L, std::plus<long>{}, 0L) == expected);
+        CHECK(Stream::of(begin, begin).parallel(pool).reduce(add, 10L, std::plus<long>{}, 0L) == 10);
+        CHECK(Stream::of(begin, begin).parallel(pool).deterministic().reduce(add, 10L, std::plus<long>{}, 0L) == 10);
+
+        auto halves = Stream::of(begin, end).parallel(pool).map([](int x) { return x * 0.5; });
+        auto addHalves = [](double x, double accu) { return accu + x; };
+        auto halvesExpected = Stream::of(begin, end).map([](int x) { return x * 0.5; }).reduce(addHalves, 0.25);
+        CHECK(halves.deterministic(64).reduce(addHalves, 0.25, std::plus<double>{}, 0.0) == halvesExpected);
+
+        auto twos = Stream::of(begin, begin + 40).parallel(pool).map([](int) { return 2.0; });
+        auto multiply = [](double x, double accu) { return accu * x; };
+        CHECK(twos.reduce(multiply, 3.0, std::multiplies<double>{}, 1.0) == 3.0 * (1LL << 40));
+        CHECK(twos.deterministic(3).reduce(multiply, 3.0, std::multiplies<double>{}, 1.0) == 3.0 * (1LL << 40));
+
+        int small[5] = { 3, 1, 5, 2, 4 };
+        auto multiplyInts = [](int x, long accu) { return accu * x; };
+        auto minimum = [](long x, long accu) { return x < accu ? x : accu; };
+        CHECK(Stream::of(small).parallel(pool).reduce(multiplyInts, 1L, std::multiplies<long>{}, 1L) == 120);
+        CHECK(Stream::of(small).parallel(pool).deterministic(1).reduce(multiplyInts, 2L, std::multiplies<long>{}, 1L) == 240);
+        CHECK(Stream::of(small).parallel(pool).reduce(minimum, 100L, minimum, std::numeric_limits<long>::max()) == 1);
+        CHECK(Stream::of(small).parallel(pool).deterministic(2).reduce(minimum, 0L, minimum, std::numeric_limits<long>::max()) == 0);
+
+        auto letters = Stream::of(begin, begin + 100).parallel(pool).map([](int x) { return std::string(1, static_cast<char>('a' + x)); });
+        auto append = [](std::string x, std::string accu) { return accu + x; };
+        auto joined = Stream::of(begin, begin + 100).map([](int x) { return std::string(1, static_cast<char>('a' + x)); }).reduce(append, std::string{ ">" });
+        CHECK(letters.reduce(append, std::string{ ">" }, append, std::string{}) == joined);
+        CHECK(letters.deterministic(7).reduce(append, std::string{ ">" }, append, std::string{}) == joined);
+    }
+
+    return Check::result();
+}
@@ -0,0 +1,77 @@
+#include "streams.h"
+#include "check.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+    using Errors = std::vector<std::pair<std::string, std::errc>>;
+
+    struct RecordErrors {
+        Errors* errors;
+
+        void operator()(std::string_view str, std::errc error) const {
+            errors->emplace_back(std::string{ str }, error);
+        }
+    };
+
+    template<typename TStream>
+    auto collect(TStream stream) {
+        std::vector<decltype(stream.getIterator().next())> result;
+        stream.emplaceInto(result);
+        return result;
+    }
+}
+
+int main() {
+    const std::vector<std::string_view> ints{ "12", "-7", "3x", "", "99999999999", " 4", "2147483647", "+1" };
+    Errors errors;
+    CHECK((collect(Stream::of(ints).parseInts<int>(RecordErrors{ &errors })) == std::vector<int>{ 12, -7, 2147483647 }));
+    CHECK((errors == Errors{ { "3x", std::errc::invalid_argument }, { "", std::errc::invalid_argument }, { "99999999999", std::errc::result_out_of_range },
+                             { " 4", std::errc::invalid_argument }, { "+1", std::errc::invalid_argument } }));
+    CHECK((collect(Stream::of(ints).parseInts<long long>()) == std::vector<long long>{ 12, -7, 99999999999LL, 2147483647 }));
+
+    const std::vector<std::string_view> doubles{ "1.5", "-2e3", "1e999", "0.25abc", "abc", "7" };
+    errors.clear();
+    CHECK((collect(Stream::of(doubles).parseDoubles(RecordErrors{ &errors })) == std::vector<double>{ 1.5, -2000.0, 7.0 }));
+    CHECK((errors == Errors{ { "1e999", std::errc::result_out_of_range }, { "0.25abc", std::errc::invalid_argument }, { "abc", std::errc::invalid_argument } }));
+
+    const std::vector<std::string_view> eight{ "12345678", "00000042", "1234567x", "1234/678", "123:5678", "1234567", "123456789" };
+    errors.clear();
+    CHECK((collect(Stream::of(eight).parseFixedInts<int, 8>(RecordErrors{ &errors })) == std::vector<int>{ 12345678, 42 }));
+    CHECK(errors.size() == 5);
+    for (auto& error : errors) {
+        CHECK(error.second == std::errc::invalid_argument);
+    }
+
+    const std::vector<std::string_view> sixteen{ "1234567890123456", "0000000000000001", "12345678901234a6" };
+    CHECK((collect(Stream::of(sixteen).parseFixedInts<std::int64_t, 16>()) == std::vector<std::int64_t>{ 1234567890123456, 1 }));
+
+    const std::vector<std::string_view> nineteen{ "9223372036854775807", "9223372036854775808", "0000000000000000042", "12345678901234567x9" };
+    errors.clear();
+    CHECK((collect(Stream::of(nineteen).parseFixedInts<std::int64_t, 19>(RecordErrors{ &errors })) == std::vector<std::int64_t>{ 9223372036854775807, 42 }));
+    CHECK((errors == Errors{ { "9223372036854775808", std::errc::result_out_of_range }, { "12345678901234567x9", std::errc::invalid_argument } }));
+    CHECK((collect(Stream::of(nineteen).parseFixedInts<std::uint64_t, 19>()) == std::vector<std::uint64_t>{ 9223372036854775807ULL, 9223372036854775808ULL, 42 }));
+
+    std::string wide;
+    std::vector<int> wideExpected;
+    for (int i = 0; i < 40; i++) {
+        wide += (i ? "," : "") + std::to_string(i * 3);
+        wideExpected.push_back(i * 3);
+    }
+    const std::vector<std::string_view> lines{ "1,2,3", "4,,x,5", "6", wide, "99999999999,7" };
+    errors.clear();
+    auto fields = collect(Stream::of(lines).parseIntFields<int>(',', RecordErrors{ &errors }));
+    std::vector<int> fieldsExpected{ 1, 2, 3, 4, 5, 6 };
+    fieldsExpected.insert(fieldsExpected.end(), wideExpected.begin(), wideExpected.end());
+    fieldsExpected.push_back(7);
+    CHECK(fields == fieldsExpected);
+    CHECK((errors == Errors{ { "", std::errc::invalid_argument }, { "x", std::errc::invalid_argument }, { "99999999999", std::errc::result_out_of_range } }));
+
+    CHECK((collect(Stream::of(lines).parseDoubleFields(';')) == std::vector<double>{ 6.0 }));
+
+    return Check::result();
+}
@@ -0,0 +1,41 @@
+#include "streams_parallel.h"
+#include "check.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+    template<typename T, typename TStream>
+    std::vector<T> collect(TStream stream) {
+        std::vector<T> result;
+        stream.emplaceInto(result);
+        return result;
+    }
+}
+
+int main() {
+    auto doubles = collect<double>(Stream::random<double>(42).limit(100003));
+    auto floats = collect<float>(Stream::random<float>(7).limit(999));
+    auto words = collect<std::uint64_t>(Stream::random<std::uint64_t>(5).limit(4099));
+    auto normal = collect<double>(Stream::random<double>(9, std::normal_distribution<double>{ 5.0, 2.0 }).limit(20001));
+    auto dice = collect<int>(Stream::random<int>(11, std::uniform_int_distribution<int>{ 1, 6 }).limit(5000));
+
+    CHECK(collect<double>(Stream::random<double>(42).limit(100003)) == doubles);
+    CHECK(collect<double>(Stream::random<double>(43).limit(10))[0] != doubles[0]);
+    for (double x : doubles) {
+        CHECK(x >= 0.0 && x < 1.0);
+    }
+
+    for (int threads : { 1, 2, 3, 4 }) {
+        Stream::ThreadPool pool{ { threads, {}, {} } };
+        CHECK(collect<double>(Stream::random<double>(42).limit(100003).parallel(pool)) == doubles);
+        CHECK(collect<double>(Stream::random<double>(42).parallel(pool).limit(100003)) == doubles);
+        CHECK(collect<float>(Stream::random<float>(7).limit(999).parallel(pool)) == floats);
+        CHECK(collect<std::uint64_t>(Stream::random<std::uint64_t>(5).limit(4099).parallel(pool)) == words);
+        CHECK(collect<double>(Stream::random<double>(9, std::normal_distribution<double>{ 5.0, 2.0 }).parallel(pool).limit(20001)) == normal);
+        CHECK(collect<int>(Stream::random<int>(11, std::uniform_int_distribution<int>{ 1, 6 }).limit(5000).parallel(pool)) == dice);
+    }
+
+    return Check::result();
+}
@@ -0,0 +1,61 @@
+#include "streams.h"
+#include "check.h"
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <numeric>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+int main() {
+    std::vector<int> data(1000);
+    std::iota(data.begin(), data.end(), 0);
+    const int* begin = data.data();
+    const int* end = data.data() + data.size();
+    auto square = [](int x) { return static_cast<long>(x) * x; };
+
+    CHECK(Stream::of(begin, end).map(square).get(31) == 961);
+    CHECK(Stream::of(begin, end).map(square).last() == 999L * 999);
+    CHECK(Stream::of(begin, end).map(square).reverse().get(0) == 999L * 999);
+    CHECK(Stream::of(begin, end).reverse().reverse().get(5) == 5);
+
+    std::vector<long> reversed;
+    Stream::of(begin, begin + 4).map(square).reverse().emplaceInto(reversed);
+    CHECK((reversed == std::vector<long>{ 9, 4, 1, 0 }));
+
+    auto consumed = Stream::of(begin, end);
+    consumed.getIterator().next();
+    CHECK(consumed.reverse().last() == 1);
+
+    std::vector<int> twos(500, 2);
+    auto products = Stream::of(begin, end).zip(Stream::of(twos.data(), twos.data() + twos.size()), [](int a, int b) { return a * b; }).view();
+    CHECK(products.size() == 500);
+    CHECK(products[499] == 998);
+    auto pair = Stream::of(begin, end).zip(Stream::of(twos.data(), twos.data() + twos.size())).last();
+    CHECK(pair.first == 499 && pair.second == 2);
+
+    auto squares = Stream::of(begin, end).map(square).view();
+    using TViewIterator = decltype(squares.begin());
+    static_assert(std::random_access_iterator<TViewIterator>);
+    static_assert(std::ranges::random_access_range<decltype(squares)>);
+    CHECK(!squares.empty());
+    CHECK(squares.end() - squares.begin() == 1000);
+    CHECK(std::lower_bound(squares.begin(), squares.end(), 250000L) - squares.begin() == 500);
+    CHECK(std::ranges::binary_search(squares, 998001L));
+    CHECK(*(squares.end() - 1) == 998001L);
+    CHECK(squares.begin()[7] == 49);
+
+    int values[3] = { 1, 2, 3 };
+    auto reversedArray = Stream::of(values).reverse().toArray();
+    CHECK(reversedArray[0] == 3 && reversedArray[2] == 1);
+
+    std::list<int> list{ 1, 2, 3, 4 };
+    CHECK(Stream::of(list).get(2) == 3);
+    CHECK(Stream::of(list).map([](int x) { return x + 1; }).last() == 5);
+    CHECK_THROWS(Stream::of(list).get(10), Stream::Detail::Exception);
+    CHECK_THROWS(Stream::of(begin, begin).map(square).last(), Stream::Detail::Exception);
+
+    return Check::result();
+}
@@ -0,0 +1,65 @@
+#include "streams.h"
+#include "check.h"
+
+#include <algorithm>
+#include <list>
+#include <numeric>
+#include <ranges>
+#include <set>
+#include <string>
+#include <vector>
+
+int main() {
+    std::vector<int> values{ 1, 2, 3, 4, 5 };
+    auto doubled = Stream::of(values).map([](int x) { return x * 2; });
+    static_assert(std::ranges::input_range<decltype(doubled)>);
+    static_assert(std::ranges::common_range<decltype(doubled)>);
+    CHECK(std::accumulate(doubled.begin(), doubled.end(), 0) == 30);
+
+    std::vector<int> odd{ 1, 2, 3, 4, 5 };
+    int total = 0;
+    for (int x : Stream::of(odd).filter([](int x) { return x % 2 != 0; })) {
+        total += x;
+    }
+    CHECK(total == 9);
+
+    std::vector<int> taken;
+    for (int x : Stream::iota(0, 100) | std::views::take(4)) {
+        taken.push_back(x);
+    }
+    CHECK((taken == std::vector<int>{ 0, 1, 2, 3 }));
+
+    std::list<std::string> words{ "a", "b", "c" };
+    std::string joined;
+    for (auto& word : Stream::of(words).map([](std::string x) { return x + "!"; })) {
+        joined += word;
+    }
+    CHECK(joined == "a!b!c!");
+
+    auto filtered = std::views::iota(0, 10) | std::views::filter([](int x) { return x % 3 == 0; });
+    CHECK(Stream::of(filtered).map([](int x) { return x * 10; }).reduce([](int x, int accu) { return accu + x; }, 0) == 180);
+    CHECK(Stream::of(std::views::iota(1, 5)).reduce([](int x, int accu) { return accu + x; }, 0) == 10);
+
+    std::set<int> ordered{ 3, 1, 2 };
+    std::vector<int> fromSet;
+    Stream::of(ordered).emplaceInto(fromSet);
+    CHECK((fromSet == std::vector<int>{ 1, 2, 3 }));
+
+    std::vector<int> data(100);
+    std::iota(data.begin(), data.end(), 0);
+    auto view = Stream::of(data.data(), data.data() + data.size()).map([](int x) { return x * 3; }).map([](int x) { return x + 1; }).view();
+    static_assert(std::ranges::random_access_range<decltype(view)>);
+    static_assert(std::ranges::sized_range<decltype(view)>);
+    CHECK(view.size() == 100);
+    CHECK(std::ranges::distance(view) == 100);
+    CHECK(std::reduce(view.begin(), view.end(), 0L) == 3L * 4950 + 100);
+    CHECK(std::ranges::lower_bound(view, 31) - view.begin() == 10);
+
+    std::vector<int> reversed;
+    for (int x : view | std::views::reverse | std::views::take(3)) {
+        reversed.push_back(x);
+    }
+    CHECK((reversed == std::vector<int>{ 298, 295, 292 }));
+
+    return Check::result();
+}
@@ -0,0 +1,47 @@
+#include "streams_io.h"
+#include "check.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "streams_shared_lines.txt";
+    std::vector<std::string> expected;
+    {
+        std::ofstream out{ path, std::ios::binary };
+        for (int i = 0; i < 5000; i++) {
+            auto line = std::to_string(i) + std::string(static_cast<std::size_t>(i % 300), 'a' + i % 26);
+            out << line << '\n';
+            expected.push_back(Stream::Detail::move(line));
+        }
+    }
+
+    Stream::ReadOptions options;
+    options.blockSize = 256;
+    auto share = Stream::shared(Stream::lines(path, options), 7);
+
+    std::vector<std::vector<std::string>> results(4);
+    std::vector<std::thread> threads;
+    for (auto& result : results) {
+        threads.emplace_back([&share, &result] {
+            share.consumer().forEach([&](std::string line) { result.push_back(Stream::Detail::move(line)); });
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<std::string> actual;
+    for (auto& result : results) {
+        actual.insert(actual.end(), result.begin(), result.end());
+    }
+    std::sort(actual.begin(), actual.end());
+    std::sort(expected.begin(), expected.end());
+    CHECK(actual == expected);
+
+    std::filesystem::remove(path);
+    return Check::result();
+}
@@ -0,0 +1,52 @@
+#include "streams.h"
+#include "check.h"
+
+#include <array>
+
+int main() {
+    int data[4] = { 1, 2, 3, 4 };
+    auto add = [](int x, int accu) { return accu + x; };
+
+    CHECK(Stream::of(data).reduce(add, 0) == 10);
+    CHECK((Stream::of(data).map([](int x) { return x * 2; }).toArray() == std::array<int, 4>{ 2, 4, 6, 8 }));
+
+    {
+        auto s = Stream::of(data);
+        s.getIterator().next();
+        CHECK(s.reduce(add, 0) == 9);
+    }
+    {
+        auto s = Stream::of(data).map([](int x) { return x + 1; });
+        auto it = s.begin();
+        CHECK(*it == 2);
+        ++it; // the range iterator holds 3, so 4 and 5 remain
+        int sum = 0;
+        s.forEach([&](int x) { sum += x; });
+        CHECK(sum == 9);
+    }
+    {
+        auto s = Stream::of(data);
+        s.getIterator().next();
+        s.getIterator().next();
+        int calls = 0;
+        s.tap([&](int) { calls++; }).sink();
+        CHECK(calls == 2);
+    }
+    {
+        auto s = Stream::of(data).zip(Stream::of(data), [](int a, int b) { return a * b; });
+        s.getIterator().next();
+        CHECK(s.reduce(add, 0) == 29);
+    }
+    {
+        auto s = Stream::of(data);
+        s.getIterator().next();
+        CHECK_THROWS(s.toArray(), Stream::Detail::Exception);
+    }
+    {
+        auto s = Stream::of(data);
+        s.getIterator().next();
+        CHECK((s.toArray<3>() == std::array<int, 3>{ 2, 3, 4 }));
+    }
+
+    return Check::result();
+}
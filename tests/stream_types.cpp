@@ -0,0 +1,39 @@
+#include "streams.h"
+#include "check.h"
+
+#include <type_traits>
+
+namespace {
+    using Source = Stream::StreamIterator<int*>;
+
+    struct Twice {
+        int operator()(int x) const {
+            return x * 2;
+        }
+    };
+
+    struct IsOdd {
+        bool operator()(int x) const {
+            return x % 2 != 0;
+        }
+    };
+
+    Stream::MapStream<Source, Twice> doubled(int* begin, int* end) {
+        return Stream::of(begin, end).map(Twice{});
+    }
+}
+
+static_assert(std::is_same_v<decltype(Stream::of(std::declval<int*>(), std::declval<int*>()).map(Twice{})), Stream::MapStream<Source, Twice>>);
+static_assert(std::is_same_v<decltype(Stream::of(std::declval<int*>(), std::declval<int*>()).filter(IsOdd{})), Stream::FilterStream<Source, IsOdd>>);
+static_assert(std::is_same_v<decltype(Stream::of(std::declval<int*>(), std::declval<int*>()).tap(IsOdd{})), Stream::TapStream<Source, IsOdd>>);
+static_assert(std::is_same_v<decltype(Stream::of(std::declval<int*>(), std::declval<int*>()).limit(1)), Stream::LimitStream<Source>>);
+
+int main() {
+    int data[4] = { 1, 2, 3, 4 };
+    CHECK(doubled(data, data + 4).reduce([](int x, int accu) { return accu + x; }, 0) == 20);
+
+    Stream::FilterStream<Source, IsOdd> odd = Stream::of(data + 0, data + 4).filter(IsOdd{});
+    CHECK(odd.count() == 2);
+
+    return Check::result();
+}
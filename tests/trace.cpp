@@ -0,0 +1,56 @@
+#include "streams_trace.h"
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    std::vector<long> data(100000, 1);
+    Stream::ThreadPool pool{ { 3, {}, {} } };
+    std::atomic<bool> done{ false };
+
+    Stream::startTrace();
+    std::thread producer{ [&] {
+        for (int i = 0; i < 200; i++) {
+            Stream::of(data.data(), data.data() + data.size()).parallel(pool).sink();
+        }
+        done = true;
+    } };
+
+    // Readers and resets run concurrently with the pool workers appending events.
+    int snapshots = 0;
+    while (!done) {
+        auto json = Stream::traceJson();
+        CHECK(json.size() >= 4 && json.compare(json.size() - 4, 4, "\n]}\n") == 0);
+        if (++snapshots % 8 == 0) {
+            Stream::startTrace();
+        }
+    }
+    producer.join();
+    Stream::of(data.data(), data.data() + data.size()).parallel(pool).sink();
+    Stream::stopTrace();
+
+    CHECK(Stream::traceJson().find("\"name\":\"chunk\"") != std::string::npos);
+
+    // The outer task waits for the task it queued on its own worker, so the other worker has to steal it.
+    Stream::ThreadPool pair{ { 2, {}, {} } };
+    std::atomic<bool> stolen{ false };
+    std::atomic<bool> finished{ false };
+    Stream::startTrace();
+    pair.submit([&] {
+        pair.submit([&] { stolen = true; });
+        while (!stolen) {
+            std::this_thread::yield();
+        }
+        finished = true;
+    });
+    while (!finished) {
+        std::this_thread::yield();
+    }
+    Stream::stopTrace();
+    CHECK(Stream::traceJson().find("\"name\":\"steal\",\"ph\":\"i\"") != std::string::npos);
+
+    return Check::result();
+}